@@ -1,5 +1,7 @@
 #pragma once
 
+#include <fogl/deletion_queue.hpp>
+#include <fogl/id_pool.hpp>
 #include <fogl/cref.hpp>
 #include <fogl/obj.hpp>
 #include <fogl/flags.hpp>
@@ -9,6 +11,7 @@
 #include <fogl/gl.hpp>
 
 #include <initializer_list>
+#include <cstddef>
 #include <cassert>
 
 namespace fogl {
@@ -26,9 +29,9 @@ namespace fogl {
     /// Whether the buffer is bound.
     bool is_bound() const {
       GLint bound_id;
-      glGetIntegerv(texture_type_to_binding(type), &bound_id);
+      glGetIntegerv(buffer_type_to_binding(type), &bound_id);
       auto_check_error();
-      return bound_id == id();
+      return GLuint(bound_id) == id();
     }
     /// Exception which is thrown if a buffer was not bound.
     struct not_bound : exception {
@@ -96,13 +99,17 @@ namespace fogl {
       if (this->is_null())
         return;
       GLuint id = this->id();
-      glDeleteBuffers(1, &id);
+      if (!defer_deletion(object_kind::buffer, id, this->context()))
+        glDeleteBuffers(1, &id);
       this->invalidate();
     }
-    /// Create the buffer
+    /// Create the buffer, taking the name from the current id pool if there is one.
     void create() {
       GLuint id = 0;
-      glGenBuffers(1, &id);
+      if (id_pool *pool = id_pool::current())
+        id = pool->gen_buffer();
+      else
+        glGenBuffers(1, &id);
       auto_check_error();
       this->id(id);
     }
@@ -0,0 +1,25 @@
+#pragma once
+
+// Setup FOGL_EGL_CONTEXT_TRACKING
+// If defined, wrappers record the EGL context which created their object, and deletion queues are per context.
+// Otherwise all objects are treated as one share group and no EGL function is called. Must be the same in all translation units.
+
+#ifdef FOGL_EGL_CONTEXT_TRACKING
+#include <EGL/egl.h>
+#endif
+
+namespace fogl {
+
+  /// Identifies the context which created an object.
+  using context_handle = const void*;
+
+  /// The current context with FOGL_EGL_CONTEXT_TRACKING, otherwise null.
+  static inline context_handle current_context() {
+#ifdef FOGL_EGL_CONTEXT_TRACKING
+    return eglGetCurrentContext();
+#else
+    return nullptr;
+#endif
+  }
+
+}
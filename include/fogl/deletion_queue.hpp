@@ -0,0 +1,170 @@
+#pragma once
+
+#include <fogl/context.hpp>
+#include <fogl/check.hpp>
+#include <fogl/error.hpp>
+#include <fogl/exception.hpp>
+#include <fogl/gl.hpp>
+
+#include <atomic>
+#include <new>
+#include <thread>
+#include <vector>
+#include <cstddef>
+
+namespace fogl {
+
+  /// Kinds of opengl objects which can be deleted by a deletion_queue.
+  enum class object_kind {
+    buffer,
+    texture,
+    shader,
+    program,
+  };
+
+  /// Queue of opengl names to delete, for the contexts of one share group.
+  /// Wrapper destructors push the names of objects created by such a context from any thread without locking,
+  /// and the GL thread drains the queue once per frame with one glDelete call per kind of object.
+  /// Contexts are only told apart with FOGL_EGL_CONTEXT_TRACKING, otherwise all objects belong to one share group.
+  /// Names of contexts without a queue are deleted immediately.
+  struct deletion_queue {
+  private:
+    struct node {
+      object_kind kind;
+      GLuint id;
+      node *next;
+    };
+    /// A context and the head of the list of its queue, null if the slot is free.
+    /// users counts the pushers which might still use the list.
+    struct slot {
+      std::atomic<bool> claimed;
+      std::atomic<context_handle> context;
+      std::atomic<std::atomic<node*>*> head;
+      std::atomic<unsigned> users;
+    };
+    /// Maximum number of contexts with a queue.
+    static const size_t max_contexts = 16;
+    /// The slots, zero initialized as static storage.
+    static slot *slots() {
+      static slot s[max_contexts];
+      return s;
+    }
+    std::atomic<node*> head_;
+    std::vector<slot*> slots_;
+    std::vector<GLuint> buffers_;
+    std::vector<GLuint> textures_;
+    /// Push to a list. Returns false if the node cannot be allocated.
+    static bool push(std::atomic<node*> &head, object_kind kind, GLuint id) {
+      node *n = new (std::nothrow) node{kind, id, head.load(std::memory_order_relaxed)};
+      if (!n)
+        return false;
+      while (!head.compare_exchange_weak(n->next, n, std::memory_order_release, std::memory_order_relaxed)) {
+      }
+      return true;
+    }
+  public:
+    /// Exception which is thrown if more than max_contexts contexts have a queue.
+    struct too_many_contexts : exception {
+    };
+    /// Queue a name for deletion. Lock free, callable from any thread. Returns false if out of memory.
+    bool push(object_kind kind, GLuint id) {
+      return push(head_, kind, id);
+    }
+    /// Delete all queued names. The context must be current. Returns the number of deleted objects.
+    /// Buffers and textures are deleted with one call each, shaders and programs have no batched delete.
+    size_t drain() {
+      node *n = head_.exchange(nullptr, std::memory_order_acquire);
+      size_t count = 0;
+      buffers_.clear();
+      textures_.clear();
+      while (n) {
+        switch (n->kind) {
+          case object_kind::buffer: buffers_.push_back(n->id); break;
+          case object_kind::texture: textures_.push_back(n->id); break;
+          case object_kind::shader: glDeleteShader(n->id); break;
+          case object_kind::program: glDeleteProgram(n->id); break;
+        }
+        node *next = n->next;
+        delete n;
+        n = next;
+        ++count;
+      }
+      if (!buffers_.empty())
+        glDeleteBuffers(GLsizei(buffers_.size()), buffers_.data());
+      if (!textures_.empty())
+        glDeleteTextures(GLsizei(textures_.size()), textures_.data());
+      auto_check_error();
+      return count;
+    }
+    /// Whether there are names waiting for deletion.
+    bool empty() const {
+      return head_.load(std::memory_order_acquire) == nullptr;
+    }
+    /// Also take the names of objects created by another context of the share group, e.g. the context of an uploader.
+    void share(context_handle context) {
+      slot *s = slots();
+      for (size_t i = 0; i < max_contexts; ++i) {
+        bool free = false;
+        if (s[i].claimed.compare_exchange_strong(free, true)) {
+          s[i].context.store(context);
+          s[i].head.store(&head_);
+          slots_.push_back(&s[i]);
+          return;
+        }
+      }
+      throw too_many_contexts();
+    }
+    /// Defer the deletion of a name to the queue of the context which created it. Lock free.
+    /// Returns false if the caller has to delete the name immediately, because no queue takes names of the context.
+    /// With FOGL_EGL_CONTEXT_TRACKING a name is leaked instead if no context is current, as it cannot be deleted.
+    static bool defer(object_kind kind, GLuint id, context_handle context) {
+      slot *s = slots();
+      for (size_t i = 0; i < max_contexts; ++i) {
+        if (!s[i].head.load() || s[i].context.load() != context)
+          continue;
+        // The queue waits for users to drop to zero after clearing head, so a head seen here stays valid until the decrement.
+        s[i].users.fetch_add(1);
+        std::atomic<node*> *head = s[i].head.load();
+        bool pushed = head && s[i].context.load() == context && push(*head, kind, id);
+        s[i].users.fetch_sub(1);
+        if (pushed)
+          return true;
+      }
+#ifdef FOGL_EGL_CONTEXT_TRACKING
+      return eglGetCurrentContext() == EGL_NO_CONTEXT;
+#else
+      return false;
+#endif
+    }
+    /// Construct empty and register for a context, by default the current one. A context has at most one queue.
+    deletion_queue(context_handle context = current_context()) : head_(nullptr) {
+      share(context);
+    }
+    deletion_queue(const deletion_queue&) = delete;
+    deletion_queue &operator=(const deletion_queue&) = delete;
+    /// Unregister the queue, so that later deletions of its contexts are immediate again, and wait for concurrent pushes.
+    /// Names which were not drained are leaked, since there might be no current context.
+    ~deletion_queue() {
+      for (slot *s : slots_)
+        s->head.store(nullptr);
+      for (slot *s : slots_) {
+        while (s->users.load() != 0)
+          std::this_thread::yield();
+        s->context.store(nullptr);
+        s->claimed.store(false);
+      }
+      node *n = head_.exchange(nullptr);
+      while (n) {
+        node *next = n->next;
+        delete n;
+        n = next;
+      }
+    }
+  };
+
+  /// Defer the deletion of a name to the queue of the context which created it. Returns false if it has to be deleted immediately.
+  static inline bool defer_deletion(object_kind kind, GLuint id, context_handle context) {
+    return deletion_queue::defer(kind, id, context);
+  }
+
+}
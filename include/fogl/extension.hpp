@@ -0,0 +1,37 @@
+#pragma once
+
+#include <fogl/gl.hpp>
+
+#include <EGL/egl.h>
+
+#include <cstring>
+
+namespace fogl {
+
+  /// Whether a space separated extension list contains an extension.
+  static inline bool extension_list_contains(const char *list, const char *name) {
+    if (!list)
+      return false;
+    size_t len = std::strlen(name);
+    for (const char *p = std::strstr(list, name); p; p = std::strstr(p + len, name))
+      if ((p == list || p[-1] == ' ') && (p[len] == ' ' || p[len] == 0))
+        return true;
+    return false;
+  }
+
+  /// Whether the current context supports an extension.
+  static inline bool has_extension(const char *name) {
+    return extension_list_contains(reinterpret_cast<const char*>(glGetString(GL_EXTENSIONS)), name);
+  }
+
+  /// Whether an EGL display supports an extension.
+  static inline bool has_egl_extension(EGLDisplay display, const char *name) {
+    return extension_list_contains(eglQueryString(display, EGL_EXTENSIONS), name);
+  }
+
+  /// Address of an extension function, or null if it is not available.
+  template<typename f> static inline f proc_address(const char *name) {
+    return reinterpret_cast<f>(eglGetProcAddress(name));
+  }
+
+}
@@ -1,11 +1,22 @@
 #pragma once
 
+#include <fogl/pipeline_state.hpp>
+#include <fogl/uploader.hpp>
+#include <fogl/instancing.hpp>
+#include <fogl/vertex_pack.hpp>
+#include <fogl/mesh.hpp>
+#include <fogl/program_interface.hpp>
 #include <fogl/program.hpp>
 #include <fogl/shader.hpp>
+#include <fogl/glsl.hpp>
 #include <fogl/texture.hpp>
 #include <fogl/buffer.hpp>
 #include <fogl/cref.hpp>
 #include <fogl/obj.hpp>
+#include <fogl/id_pool.hpp>
+#include <fogl/deletion_queue.hpp>
+#include <fogl/context.hpp>
+#include <fogl/extension.hpp>
 #include <fogl/error.hpp>
 #include <fogl/exception.hpp>
 #include <fogl/check.hpp>
@@ -2,3 +2,5 @@
 
 /// The include of the gl implementation.
 #include <GLES2/gl2.h>
+/// The include of the gl extension definitions.
+#include <GLES2/gl2ext.h>
@@ -0,0 +1,171 @@
+#pragma once
+
+#include <cstddef>
+
+namespace fogl {
+
+  /// GLSL source in a fixed size array, built at compile time.
+  template<size_t n> struct glsl_source {
+  private:
+    char data_[n + 1];
+    size_t size_;
+  public:
+    /// The null terminated source.
+    constexpr const char *c_str() const {
+      return data_;
+    }
+    /// The length of the source.
+    constexpr size_t size() const {
+      return size_;
+    }
+    /// The last character, or 0 if empty.
+    constexpr char back() const {
+      return size_ == 0 ? 0 : data_[size_ - 1];
+    }
+    /// Append a character.
+    constexpr void push_back(char c) {
+      data_[size_++] = c;
+      data_[size_] = 0;
+    }
+    /// Append characters.
+    constexpr void append(const char *s, size_t len) {
+      for (size_t i = 0; i < len; ++i)
+        push_back(s[i]);
+    }
+    /// Construct empty.
+    constexpr glsl_source() : data_{}, size_(0) {
+    }
+  };
+
+  /// Pointer and length of a part of GLSL source.
+  struct glsl_part {
+    const char *data;
+    size_t size;
+  };
+
+  /// Part of a string literal.
+  template<size_t n> constexpr glsl_part glsl_part_of(const char (&s)[n]) {
+    return glsl_part{s, n - 1};
+  }
+
+  /// Part of composed source.
+  template<size_t n> constexpr glsl_part glsl_part_of(const glsl_source<n> &s) {
+    return glsl_part{s.c_str(), s.size()};
+  }
+
+  /// Maximum length of a part.
+  template<typename t> struct glsl_capacity;
+  template<size_t n> struct glsl_capacity<char[n]> {
+    static constexpr size_t value = n - 1;
+  };
+  template<size_t n> struct glsl_capacity<glsl_source<n>> {
+    static constexpr size_t value = n;
+  };
+
+  static inline constexpr size_t glsl_sum() {
+    return 0;
+  }
+  template<typename... rest> constexpr size_t glsl_sum(size_t first, rest... r) {
+    return first + glsl_sum(r...);
+  }
+
+  static inline constexpr bool glsl_is_word(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_' || c == '.';
+  }
+
+  static inline constexpr bool glsl_is_operator(char c) {
+    return c == '+' || c == '-' || c == '*' || c == '/' || c == '%' || c == '<' || c == '>' || c == '=' || c == '!' || c == '&' || c == '|' || c == '^';
+  }
+
+  static inline constexpr bool glsl_is_space(char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\f' || c == '\v';
+  }
+
+  /// Append source without comments and with minimal whitespace. Preprocessor directives keep their own lines.
+  template<size_t n> constexpr void glsl_minify(glsl_source<n> &out, const char *s, size_t len) {
+    bool line_start = true;
+    bool directive = false;
+    bool space = false;
+    size_t i = 0;
+    while (i < len) {
+      char c = s[i];
+      if (c == '/' && i + 1 < len && s[i + 1] == '/') {
+        while (i < len && s[i] != '\n')
+          ++i;
+        continue;
+      }
+      if (c == '/' && i + 1 < len && s[i + 1] == '*') {
+        i += 2;
+        while (i + 1 < len && !(s[i] == '*' && s[i + 1] == '/'))
+          ++i;
+        i += 2;
+        space = true;
+        continue;
+      }
+      ++i;
+      if (c == '\n') {
+        if (directive)
+          out.push_back('\n');
+        space = !directive;
+        directive = false;
+        line_start = true;
+        continue;
+      }
+      if (glsl_is_space(c)) {
+        space = true;
+        continue;
+      }
+      char last = out.back();
+      if (line_start && c == '#') {
+        if (out.size() != 0 && last != '\n')
+          out.push_back('\n');
+        directive = true;
+      } else if (space && out.size() != 0 && last != '\n') {
+        if (directive || (glsl_is_word(last) && glsl_is_word(c)) || (glsl_is_operator(last) && glsl_is_operator(c)))
+          out.push_back(' ');
+      }
+      space = false;
+      line_start = false;
+      out.push_back(c);
+    }
+    if (directive)
+      out.push_back('\n');
+  }
+
+  /// Join parts of GLSL source, which are string literals or composed source, and strip comments and whitespace.
+  /// Evaluated at compile time when assigned to a constexpr variable.
+  template<typename... parts> constexpr glsl_source<glsl_sum(glsl_capacity<parts>::value...) + sizeof...(parts) + 1> glsl(const parts &... p) {
+    glsl_source<glsl_sum(glsl_capacity<parts>::value...) + sizeof...(parts)> joined;
+    glsl_part list[] = {glsl_part{"", 0}, glsl_part_of(p)...};
+    for (const glsl_part &part : list) {
+      joined.append(part.data, part.size);
+      // Keep parts on separate lines, a part might end in a line comment or directive.
+      if (part.size != 0)
+        joined.push_back('\n');
+    }
+    glsl_source<glsl_sum(glsl_capacity<parts>::value...) + sizeof...(parts) + 1> out;
+    glsl_minify(out, joined.c_str(), joined.size());
+    return out;
+  }
+
+  /// A #define directive of a name without value.
+  template<size_t a> constexpr glsl_source<a + 8> glsl_define(const char (&name)[a]) {
+    glsl_source<a + 8> out;
+    out.append("#define ", 8);
+    out.append(name, a - 1);
+    out.push_back('\n');
+    return out;
+  }
+
+  /// A #define directive of a name with a value.
+  template<size_t a, size_t b> constexpr glsl_source<a + b + 8> glsl_define(const char (&name)[a], const char (&value)[b]) {
+    glsl_source<a + b + 8> out;
+    out.append("#define ", 8);
+    out.append(name, a - 1);
+    out.push_back(' ');
+    out.append(value, b - 1);
+    out.push_back('\n');
+    return out;
+  }
+
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <fogl/check.hpp>
+#include <fogl/error.hpp>
+#include <fogl/gl.hpp>
+
+#include <vector>
+
+namespace fogl {
+
+  /// Pool of pre-generated buffer and texture names, so that creating an object does not call into the driver each time.
+  /// A pool belongs to the thread it is made current on, whose context must stay current while it is used.
+  struct id_pool {
+  private:
+    GLsizei batch_;
+    std::vector<GLuint> buffers_;
+    std::vector<GLuint> textures_;
+    /// The current pool of this thread.
+    static id_pool *&target() {
+      static thread_local id_pool *pool = nullptr;
+      return pool;
+    }
+  public:
+    /// Take a buffer name, generating batch names at once if the pool is empty.
+    GLuint gen_buffer() {
+      if (buffers_.empty()) {
+        buffers_.resize(batch_);
+        glGenBuffers(batch_, buffers_.data());
+        auto_check_error();
+      }
+      GLuint id = buffers_.back();
+      buffers_.pop_back();
+      return id;
+    }
+    /// Take a texture name, generating batch names at once if the pool is empty.
+    GLuint gen_texture() {
+      if (textures_.empty()) {
+        textures_.resize(batch_);
+        glGenTextures(batch_, textures_.data());
+        auto_check_error();
+      }
+      GLuint id = textures_.back();
+      textures_.pop_back();
+      return id;
+    }
+    /// Make a pool the current pool of this thread, which is used by create() of buffers and textures. Null disables pooling.
+    static void make_current(id_pool *pool) {
+      target() = pool;
+    }
+    /// The current pool of this thread, or null.
+    static id_pool *current() {
+      return target();
+    }
+    /// Construct empty. Names are generated batch at a time.
+    id_pool(GLsizei batch = 64) : batch_(batch) {
+    }
+    id_pool(const id_pool&) = delete;
+    id_pool &operator=(const id_pool&) = delete;
+    /// Delete the unused names. The context must be current.
+    ~id_pool() {
+      if (target() == this)
+        target() = nullptr;
+      if (!buffers_.empty())
+        glDeleteBuffers(GLsizei(buffers_.size()), buffers_.data());
+      if (!textures_.empty())
+        glDeleteTextures(GLsizei(textures_.size()), textures_.data());
+    }
+  };
+
+}
@@ -0,0 +1,219 @@
+#pragma once
+
+#include <fogl/mesh.hpp>
+#include <fogl/program.hpp>
+#include <fogl/buffer.hpp>
+#include <fogl/extension.hpp>
+#include <fogl/flags.hpp>
+#include <fogl/check.hpp>
+#include <fogl/error.hpp>
+#include <fogl/exception.hpp>
+#include <fogl/gl.hpp>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <cassert>
+
+namespace fogl {
+
+  /// Entry points of ANGLE_instanced_arrays or EXT_instanced_arrays.
+  struct instanced_arrays {
+    /// glDrawElementsInstanced, or null if not available.
+    PFNGLDRAWELEMENTSINSTANCEDEXTPROC draw_elements;
+    /// glVertexAttribDivisor, or null if not available.
+    PFNGLVERTEXATTRIBDIVISOREXTPROC divisor;
+    /// Whether instanced arrays are available.
+    bool available() const {
+      return draw_elements && divisor;
+    }
+    /// Construct without instanced arrays.
+    instanced_arrays() : draw_elements(nullptr), divisor(nullptr) {
+    }
+    /// Load the entry points for the current context.
+    static instanced_arrays load() {
+      instanced_arrays ia;
+      if (has_extension("GL_ANGLE_instanced_arrays")) {
+        ia.draw_elements = proc_address<PFNGLDRAWELEMENTSINSTANCEDEXTPROC>("glDrawElementsInstancedANGLE");
+        ia.divisor = proc_address<PFNGLVERTEXATTRIBDIVISOREXTPROC>("glVertexAttribDivisorANGLE");
+      } else if (has_extension("GL_EXT_instanced_arrays")) {
+        ia.draw_elements = proc_address<PFNGLDRAWELEMENTSINSTANCEDEXTPROC>("glDrawElementsInstancedEXT");
+        ia.divisor = proc_address<PFNGLVERTEXATTRIBDIVISOREXTPROC>("glVertexAttribDivisorEXT");
+      }
+      return ia;
+    }
+  };
+
+  /// Exception which is thrown if not even one instance fits into the uniform budget of the fallback.
+  struct instancing_unsupported : exception {
+  };
+
+  /// A mesh which is drawn many times with per instance data of a number of vec4 each.
+  /// Uses instanced arrays if available. Otherwise the mesh is replicated into a buffer with a per vertex instance index
+  /// and the instance data is passed in uniform arrays, so one draw call covers a whole batch of instances.
+  /// The vertex shader has to start with glsl(), call fogl_load_instance() and then read fogl_instance[0 .. vectors - 1].
+  struct instanced_mesh {
+  private:
+    instanced_arrays ext_;
+    array_buffer vertices_;
+    array_buffer instance_ids_;
+    array_buffer instances_;
+    element_array_buffer indices_;
+    GLsizei index_count_;
+    GLsizei vectors_;
+    GLsizei batch_;
+    GLuint program_;
+    std::vector<GLuint> locations_;
+    GLint uniform_location_;
+    /// Look up the locations of the instancing attributes and uniforms.
+    void locate(program_cref program) {
+      if (program.id() == program_)
+        return;
+      locations_.clear();
+      if (native()) {
+        for (GLsizei k = 0; k < vectors_; ++k)
+          locations_.push_back(program.attribute_location(("fogl_instance_attrib" + std::to_string(k)).c_str()));
+      } else {
+        locations_.push_back(program.attribute_location("fogl_instance_index"));
+        uniform_location_ = GLint(program.uniform_location("fogl_instances"));
+      }
+      program_ = program.id();
+    }
+  public:
+    /// Construct and upload the mesh. The context must be current.
+    /// reserved_uniform_vectors are kept free for other uniforms of the vertex shader in the fallback.
+    instanced_mesh(const mesh16 &m, GLsizei vectors_per_instance, GLsizei reserved_uniform_vectors = 16, bool allow_instanced_arrays = true) :
+        vertices_(create()), indices_(create()), index_count_(GLsizei(m.indices.size())), vectors_(vectors_per_instance), batch_(1), program_(0), uniform_location_(-1) {
+      assert(vectors_per_instance > 0);
+      if (allow_instanced_arrays)
+        ext_ = instanced_arrays::load();
+      if (native()) {
+        instances_.create();
+        vertices_->bind();
+        vertices_->data(m.vertices.data(), m.vertices.size());
+        indices_->bind();
+        indices_->data(m.indices.data(), m.indices.size() * sizeof(GLushort));
+        return;
+      }
+      GLint max_vectors = 0;
+      glGetIntegerv(GL_MAX_VERTEX_UNIFORM_VECTORS, &max_vectors);
+      auto_check_error();
+      batch_ = (max_vectors - reserved_uniform_vectors) / vectors_;
+      batch_ = std::min<GLsizei>(batch_, GLsizei(65536 / std::max<size_t>(m.vertex_count(), 1)));
+      if (batch_ < 1)
+        throw instancing_unsupported();
+      size_t vertex_count = m.vertex_count();
+      std::vector<unsigned char> vertices;
+      std::vector<GLfloat> ids;
+      std::vector<GLushort> indices;
+      vertices.reserve(m.vertices.size() * batch_);
+      ids.reserve(vertex_count * batch_);
+      indices.reserve(m.indices.size() * batch_);
+      for (GLsizei i = 0; i < batch_; ++i) {
+        vertices.insert(vertices.end(), m.vertices.begin(), m.vertices.end());
+        ids.insert(ids.end(), vertex_count, GLfloat(i));
+        for (GLushort index : m.indices)
+          indices.push_back(GLushort(index + i * vertex_count));
+      }
+      instance_ids_.create();
+      instance_ids_->bind();
+      instance_ids_->data(ids.data(), ids.size() * sizeof(GLfloat));
+      vertices_->bind();
+      vertices_->data(vertices.data(), vertices.size());
+      indices_->bind();
+      indices_->data(indices.data(), indices.size() * sizeof(GLushort));
+    }
+    /// Whether instanced arrays are used.
+    bool native() const {
+      return ext_.available();
+    }
+    /// Maximum number of instances per draw call of the fallback.
+    GLsizei batch_size() const {
+      return batch_;
+    }
+    /// Number of draw calls needed for a number of instances.
+    GLsizei draw_calls(GLsizei instance_count) const {
+      return native() ? 1 : (instance_count + batch_ - 1) / batch_;
+    }
+    /// GLSL declarations which have to be prepended to the vertex shader.
+    std::string glsl() const {
+      std::string v = std::to_string(vectors_);
+      std::string src;
+      if (native()) {
+        for (GLsizei k = 0; k < vectors_; ++k)
+          src += "attribute vec4 fogl_instance_attrib" + std::to_string(k) + ";\n";
+      } else {
+        src += "attribute float fogl_instance_index;\n";
+        src += "uniform vec4 fogl_instances[" + std::to_string(batch_ * vectors_) + "];\n";
+      }
+      src += "vec4 fogl_instance[" + v + "];\n";
+      src += "void fogl_load_instance() {\n";
+      if (!native())
+        src += "  int base = int(fogl_instance_index) * " + v + ";\n";
+      for (GLsizei k = 0; k < vectors_; ++k) {
+        std::string i = std::to_string(k);
+        if (native())
+          src += "  fogl_instance[" + i + "] = fogl_instance_attrib" + i + ";\n";
+        else
+          src += "  fogl_instance[" + i + "] = fogl_instances[base + " + i + "];\n";
+      }
+      src += "}\n";
+      return src;
+    }
+    /// Bind the vertex buffer, so that the attribute pointers of the mesh can be set.
+    void bind_vertices() const {
+      vertices_->bind();
+    }
+    /// Forget the cached locations, which are looked up again by the next draw().
+    /// Needed when a program is relinked, or deleted and its id reused by a new program.
+    void invalidate() {
+      program_ = 0;
+    }
+    /// Draw instances with vectors_per_instance vec4 of data each. The program must be in use.
+    /// The mode must be a list primitive, since the fallback draws the replicated indices in one call.
+    /// Locations are cached by program id until another program is drawn with or invalidate() is called.
+    void draw(program_cref program, const GLfloat *instance_data, GLsizei instance_count, GLenum mode = GL_TRIANGLES) {
+      program.auto_check_not_null();
+      if (instance_count <= 0)
+        return;
+      locate(program);
+      indices_->bind();
+      if (native()) {
+        instances_->bind();
+        instances_->data(instance_data, size_t(instance_count) * vectors_ * 4 * sizeof(GLfloat), GL_STREAM_DRAW);
+        for (GLsizei k = 0; k < vectors_; ++k) {
+          if (locations_[k] == GLuint(-1))
+            continue;
+          glEnableVertexAttribArray(locations_[k]);
+          glVertexAttribPointer(locations_[k], 4, GL_FLOAT, GL_FALSE, vectors_ * 4 * sizeof(GLfloat), reinterpret_cast<const GLvoid*>(k * 4 * sizeof(GLfloat)));
+          ext_.divisor(locations_[k], 1);
+        }
+        ext_.draw_elements(mode, index_count_, GL_UNSIGNED_SHORT, nullptr, instance_count);
+        for (GLsizei k = 0; k < vectors_; ++k) {
+          if (locations_[k] == GLuint(-1))
+            continue;
+          ext_.divisor(locations_[k], 0);
+          glDisableVertexAttribArray(locations_[k]);
+        }
+        auto_check_error();
+        return;
+      }
+      GLuint index_location = locations_[0];
+      if (index_location != GLuint(-1)) {
+        instance_ids_->bind();
+        glEnableVertexAttribArray(index_location);
+        glVertexAttribPointer(index_location, 1, GL_FLOAT, GL_FALSE, 0, nullptr);
+      }
+      for (GLsizei first = 0; first < instance_count; first += batch_) {
+        GLsizei count = std::min(batch_, instance_count - first);
+        glUniform4fv(uniform_location_, count * vectors_, instance_data + size_t(first) * vectors_ * 4);
+        glDrawElements(mode, count * index_count_, GL_UNSIGNED_SHORT, nullptr);
+      }
+      if (index_location != GLuint(-1))
+        glDisableVertexAttribArray(index_location);
+      auto_check_error();
+    }
+  };
+
+}
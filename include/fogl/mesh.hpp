@@ -0,0 +1,408 @@
+#pragma once
+
+#include <fogl/buffer.hpp>
+#include <fogl/flags.hpp>
+#include <fogl/check.hpp>
+#include <fogl/error.hpp>
+#include <fogl/exception.hpp>
+#include <fogl/gl.hpp>
+
+#include <algorithm>
+#include <vector>
+#include <cstring>
+#include <cmath>
+#include <cstdint>
+#include <cassert>
+
+namespace fogl {
+
+  /// Indexed triangle mesh with interleaved vertices.
+  struct mesh {
+    /// The raw vertex data.
+    std::vector<unsigned char> vertices;
+    /// The size of one vertex in bytes.
+    size_t stride;
+    /// Three indices per triangle.
+    std::vector<GLuint> indices;
+    /// The number of vertices.
+    size_t vertex_count() const {
+      return stride == 0 ? 0 : vertices.size() / stride;
+    }
+    /// Construct an empty mesh.
+    mesh() : stride(0) {
+    }
+    /// Construct by copying vertex and index data.
+    mesh(const void *vertices, size_t vertex_count, size_t stride, const GLuint *indices, size_t index_count) :
+        vertices(static_cast<const unsigned char*>(vertices), static_cast<const unsigned char*>(vertices) + vertex_count * stride),
+        stride(stride),
+        indices(indices, indices + index_count) {
+    }
+  };
+
+  /// Mesh with 16 bit indices, which can be drawn without OES_element_index_uint.
+  struct mesh16 {
+    /// The raw vertex data.
+    std::vector<unsigned char> vertices;
+    /// The size of one vertex in bytes.
+    size_t stride;
+    /// Three indices per triangle.
+    std::vector<GLushort> indices;
+    /// The number of vertices.
+    size_t vertex_count() const {
+      return stride == 0 ? 0 : vertices.size() / stride;
+    }
+    /// Construct an empty mesh.
+    mesh16() : stride(0) {
+    }
+  };
+
+  /// Statistics of a mesh optimization.
+  struct mesh_stats {
+    /// Average cache miss ratio of the input.
+    float acmr_before;
+    /// Average cache miss ratio of the output.
+    float acmr_after;
+    /// Number of vertices of the input.
+    size_t vertices_before;
+    /// Number of vertices of the output.
+    size_t vertices_after;
+  };
+
+  /// Number of vertex shader invocations with a FIFO post transform cache.
+  template<typename index> static inline size_t cache_misses(const index *indices, size_t index_count, size_t cache_size = 16) {
+    std::vector<index> cache;
+    size_t misses = 0;
+    for (size_t i = 0; i < index_count; ++i) {
+      if (std::find(cache.begin(), cache.end(), indices[i]) != cache.end())
+        continue;
+      ++misses;
+      cache.insert(cache.begin(), indices[i]);
+      if (cache.size() > cache_size)
+        cache.pop_back();
+    }
+    return misses;
+  }
+
+  /// Average cache miss ratio (vertex shader invocations per triangle) with a FIFO post transform cache.
+  template<typename index> static inline float acmr(const index *indices, size_t index_count, size_t cache_size = 16) {
+    if (index_count < 3)
+      return 0;
+    return float(cache_misses(indices, index_count, cache_size)) / float(index_count / 3);
+  }
+
+  /// Merge bytewise identical vertices. Returns the new number of vertices.
+  static inline size_t deduplicate_vertices(mesh &m) {
+    size_t count = m.vertex_count();
+    if (count == 0)
+      return 0;
+    size_t table_size = 1;
+    while (table_size < count * 2)
+      table_size *= 2;
+    const GLuint empty = GLuint(-1);
+    std::vector<GLuint> table(table_size, empty);
+    std::vector<GLuint> remap(count);
+    std::vector<unsigned char> vertices;
+    vertices.reserve(m.vertices.size());
+    for (size_t v = 0; v < count; ++v) {
+      const unsigned char *data = &m.vertices[v * m.stride];
+      uint32_t hash = 2166136261u;
+      for (size_t b = 0; b < m.stride; ++b)
+        hash = (hash ^ data[b]) * 16777619u;
+      size_t slot = hash & (table_size - 1);
+      while (table[slot] != empty && std::memcmp(&vertices[table[slot] * m.stride], data, m.stride) != 0)
+        slot = (slot + 1) & (table_size - 1);
+      if (table[slot] == empty) {
+        table[slot] = GLuint(vertices.size() / m.stride);
+        vertices.insert(vertices.end(), data, data + m.stride);
+      }
+      remap[v] = table[slot];
+    }
+    for (GLuint &i : m.indices)
+      i = remap[i];
+    m.vertices.swap(vertices);
+    return m.vertex_count();
+  }
+
+  /// Reorder the triangles for the post transform vertex cache with Tipsify (Sander et al. 2007).
+  static inline void optimize_vertex_cache(mesh &m, size_t cache_size = 16) {
+    size_t vertex_count = m.vertex_count();
+    size_t triangle_count = m.indices.size() / 3;
+    if (triangle_count == 0)
+      return;
+    // Vertex to triangle adjacency.
+    std::vector<GLuint> live(vertex_count, 0);
+    for (size_t i = 0; i < triangle_count * 3; ++i)
+      ++live[m.indices[i]];
+    std::vector<GLuint> offsets(vertex_count + 1, 0);
+    for (size_t v = 0; v < vertex_count; ++v)
+      offsets[v + 1] = offsets[v] + live[v];
+    std::vector<GLuint> adjacency(triangle_count * 3);
+    std::vector<GLuint> fill(offsets.begin(), offsets.end() - 1);
+    for (size_t i = 0; i < triangle_count * 3; ++i)
+      adjacency[fill[m.indices[i]]++] = GLuint(i / 3);
+
+    std::vector<size_t> cache_time(vertex_count, 0);
+    std::vector<bool> emitted(triangle_count, false);
+    std::vector<GLuint> dead_end;
+    std::vector<GLuint> candidates;
+    std::vector<GLuint> out;
+    out.reserve(triangle_count * 3);
+    size_t time = cache_size + 1;
+    size_t cursor = 0;
+    long fanning = m.indices[0];
+    while (fanning >= 0) {
+      candidates.clear();
+      for (GLuint a = offsets[fanning]; a < offsets[fanning + 1]; ++a) {
+        GLuint t = adjacency[a];
+        if (emitted[t])
+          continue;
+        for (size_t k = 0; k < 3; ++k) {
+          GLuint v = m.indices[t * 3 + k];
+          out.push_back(v);
+          dead_end.push_back(v);
+          candidates.push_back(v);
+          --live[v];
+          if (time - cache_time[v] > cache_size)
+            cache_time[v] = time++;
+        }
+        emitted[t] = true;
+      }
+      // Choose the next fanning vertex among the candidates which will still be in the cache.
+      fanning = -1;
+      long best_priority = -1;
+      for (GLuint v : candidates) {
+        if (live[v] == 0)
+          continue;
+        long priority = 0;
+        if (time - cache_time[v] + 2 * live[v] <= cache_size)
+          priority = long(time - cache_time[v]);
+        if (priority > best_priority) {
+          best_priority = priority;
+          fanning = v;
+        }
+      }
+      if (fanning >= 0)
+        continue;
+      // Dead end: fall back to recently used vertices, then to the input order.
+      while (!dead_end.empty() && fanning < 0) {
+        GLuint v = dead_end.back();
+        dead_end.pop_back();
+        if (live[v] > 0)
+          fanning = v;
+      }
+      while (cursor < vertex_count && fanning < 0) {
+        if (live[cursor] > 0)
+          fanning = long(cursor);
+        ++cursor;
+      }
+    }
+    m.indices.swap(out);
+  }
+
+  /// Exception which is thrown if the positions of a mesh do not fit into its vertices.
+  struct bad_position_offset : exception {
+  };
+
+  /// Reorder clusters of triangles to reduce overdraw while keeping most of the vertex cache efficiency.
+  /// Positions are three floats at the given byte offset of each vertex. Must run after optimize_vertex_cache.
+  /// A cluster is split as soon as its cache miss ratio is below threshold times the ratio of the whole mesh.
+  /// Throws bad_position_offset if three floats at the offset exceed the stride.
+  static inline void optimize_overdraw(mesh &m, size_t position_offset = 0, float threshold = 1.05f, size_t cache_size = 16) {
+    size_t triangle_count = m.indices.size() / 3;
+    if (triangle_count == 0)
+      return;
+    if (position_offset + 3 * sizeof(GLfloat) > m.stride)
+      throw bad_position_offset();
+    float mesh_acmr = acmr(m.indices.data(), m.indices.size(), cache_size);
+
+    // Find cluster boundaries: hard ones where the simulated cache runs completely cold, soft ones where a cluster is good enough on its own.
+    std::vector<size_t> clusters;
+    std::vector<GLuint> cache;
+    size_t cluster_misses = 0;
+    size_t cluster_start = 0;
+    for (size_t t = 0; t < triangle_count; ++t) {
+      bool soft = t > cluster_start && float(cluster_misses) / float(t - cluster_start) <= threshold * mesh_acmr;
+      if (soft)
+        cache.clear();
+      size_t misses = 0;
+      for (size_t k = 0; k < 3; ++k) {
+        GLuint v = m.indices[t * 3 + k];
+        if (std::find(cache.begin(), cache.end(), v) != cache.end())
+          continue;
+        ++misses;
+        cache.insert(cache.begin(), v);
+        if (cache.size() > cache_size)
+          cache.pop_back();
+      }
+      if (t == 0 || soft || misses == 3) {
+        clusters.push_back(t);
+        cluster_start = t;
+        cluster_misses = 0;
+      }
+      cluster_misses += misses;
+    }
+    clusters.push_back(triangle_count);
+
+    // Sort key: how far the area weighted cluster centroid lies in front of the mesh centroid along the cluster normal.
+    auto position = [&](GLuint v) {
+      return reinterpret_cast<const GLfloat*>(&m.vertices[v * m.stride + position_offset]);
+    };
+    size_t cluster_count = clusters.size() - 1;
+    std::vector<float> centroids(cluster_count * 3, 0.f), normals(cluster_count * 3, 0.f), areas(cluster_count, 0.f);
+    float mesh_centroid[3] = {0.f, 0.f, 0.f};
+    float mesh_area = 0.f;
+    for (size_t c = 0; c < cluster_count; ++c) {
+      for (size_t t = clusters[c]; t < clusters[c + 1]; ++t) {
+        GLfloat p[3][3];
+        for (size_t k = 0; k < 3; ++k)
+          std::memcpy(p[k], position(m.indices[t * 3 + k]), sizeof(p[k]));
+        float e1[3] = {p[1][0] - p[0][0], p[1][1] - p[0][1], p[1][2] - p[0][2]};
+        float e2[3] = {p[2][0] - p[0][0], p[2][1] - p[0][1], p[2][2] - p[0][2]};
+        float n[3] = {e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0]};
+        float area = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+        for (size_t d = 0; d < 3; ++d) {
+          float centre = (p[0][d] + p[1][d] + p[2][d]) / 3.f;
+          centroids[c * 3 + d] += centre * area;
+          normals[c * 3 + d] += n[d];
+          mesh_centroid[d] += centre * area;
+        }
+        areas[c] += area;
+        mesh_area += area;
+      }
+    }
+    for (size_t d = 0; d < 3; ++d)
+      mesh_centroid[d] = mesh_area > 0.f ? mesh_centroid[d] / mesh_area : 0.f;
+    std::vector<float> keys(cluster_count, 0.f);
+    for (size_t c = 0; c < cluster_count; ++c) {
+      if (areas[c] <= 0.f)
+        continue;
+      float *n = &normals[c * 3];
+      float length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+      if (length <= 0.f)
+        continue;
+      for (size_t d = 0; d < 3; ++d)
+        keys[c] += (centroids[c * 3 + d] / areas[c] - mesh_centroid[d]) * n[d] / length;
+    }
+
+    std::vector<size_t> order(cluster_count);
+    for (size_t c = 0; c < cluster_count; ++c)
+      order[c] = c;
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+      return keys[a] > keys[b];
+    });
+    std::vector<GLuint> out;
+    out.reserve(m.indices.size());
+    for (size_t c : order)
+      out.insert(out.end(), m.indices.begin() + clusters[c] * 3, m.indices.begin() + clusters[c + 1] * 3);
+    m.indices.swap(out);
+  }
+
+  /// Reorder the vertices in the order of their first use and drop unused ones. Returns the new number of vertices.
+  static inline size_t optimize_vertex_fetch(mesh &m) {
+    const GLuint unused = GLuint(-1);
+    std::vector<GLuint> remap(m.vertex_count(), unused);
+    std::vector<unsigned char> vertices;
+    vertices.reserve(m.vertices.size());
+    GLuint next = 0;
+    for (GLuint &i : m.indices) {
+      if (remap[i] == unused) {
+        remap[i] = next++;
+        vertices.insert(vertices.end(), &m.vertices[i * m.stride], &m.vertices[i * m.stride] + m.stride);
+      }
+      i = remap[i];
+    }
+    m.vertices.swap(vertices);
+    return m.vertex_count();
+  }
+
+  /// Split a mesh into meshes with 16 bit indices, keeping the triangle order.
+  static inline std::vector<mesh16> split_mesh16(const mesh &m, size_t max_vertices = 65536) {
+    assert(max_vertices >= 3 && max_vertices <= 65536);
+    const GLuint unused = GLuint(-1);
+    std::vector<mesh16> parts;
+    std::vector<GLuint> local(m.vertex_count(), unused);
+    std::vector<GLuint> used;
+    for (size_t t = 0; t + 2 < m.indices.size(); t += 3) {
+      size_t fresh = 0;
+      for (size_t k = 0; k < 3; ++k)
+        if (local[m.indices[t + k]] == unused)
+          ++fresh;
+      if (parts.empty() || parts.back().vertex_count() + fresh > max_vertices) {
+        for (GLuint v : used)
+          local[v] = unused;
+        used.clear();
+        parts.emplace_back();
+        parts.back().stride = m.stride;
+      }
+      mesh16 &part = parts.back();
+      for (size_t k = 0; k < 3; ++k) {
+        GLuint v = m.indices[t + k];
+        if (local[v] == unused) {
+          local[v] = GLuint(part.vertex_count());
+          used.push_back(v);
+          part.vertices.insert(part.vertices.end(), &m.vertices[v * m.stride], &m.vertices[v * m.stride] + m.stride);
+        }
+        part.indices.push_back(GLushort(local[v]));
+      }
+    }
+    return parts;
+  }
+
+  /// Run deduplication, vertex cache, overdraw and vertex fetch optimization.
+  static inline mesh_stats optimize_mesh(mesh &m, size_t position_offset = 0, float overdraw_threshold = 1.05f, size_t cache_size = 16) {
+    mesh_stats stats;
+    stats.acmr_before = acmr(m.indices.data(), m.indices.size(), cache_size);
+    stats.vertices_before = m.vertex_count();
+    deduplicate_vertices(m);
+    optimize_vertex_cache(m, cache_size);
+    optimize_overdraw(m, position_offset, overdraw_threshold, cache_size);
+    stats.vertices_after = optimize_vertex_fetch(m);
+    stats.acmr_after = acmr(m.indices.data(), m.indices.size(), cache_size);
+    return stats;
+  }
+
+  /// Uploaded mesh with 16 bit indices.
+  struct mesh_buffers {
+    /// The vertices.
+    array_buffer vertices;
+    /// The indices as GL_UNSIGNED_SHORT.
+    element_array_buffer indices;
+    /// The number of indices.
+    GLsizei count;
+    /// Draw the mesh. The vertex attributes have to be set up for the bound array buffer.
+    void draw(GLenum mode = GL_TRIANGLES) const {
+      indices->bind();
+      glDrawElements(mode, count, GL_UNSIGNED_SHORT, nullptr);
+      auto_check_error();
+    }
+    /// Create the buffers and upload the mesh. Leaves both buffers bound.
+    mesh_buffers(const mesh16 &m, GLenum usage = GL_STATIC_DRAW) : vertices(create()), indices(create()), count(GLsizei(m.indices.size())) {
+      vertices->bind();
+      vertices->data(m.vertices.data(), m.vertices.size(), usage);
+      indices->bind();
+      indices->data(m.indices.data(), m.indices.size() * sizeof(GLushort), usage);
+    }
+  };
+
+  /// Optimize a mesh, split it into parts with 16 bit indices and upload them.
+  /// The statistics describe the uploaded parts, in which vertices shared between parts are counted once per part.
+  static inline std::vector<mesh_buffers> upload_mesh(mesh m, mesh_stats *stats = nullptr, size_t position_offset = 0, GLenum usage = GL_STATIC_DRAW) {
+    mesh_stats s = optimize_mesh(m, position_offset);
+    std::vector<mesh16> parts = split_mesh16(m);
+    size_t misses = 0, triangles = 0, vertices = 0;
+    std::vector<mesh_buffers> buffers;
+    buffers.reserve(parts.size());
+    for (const mesh16 &part : parts) {
+      misses += cache_misses(part.indices.data(), part.indices.size());
+      triangles += part.indices.size() / 3;
+      vertices += part.vertex_count();
+      buffers.emplace_back(part, usage);
+    }
+    s.acmr_after = triangles == 0 ? 0.f : float(misses) / float(triangles);
+    s.vertices_after = vertices;
+    if (stats)
+      *stats = s;
+    return buffers;
+  }
+
+}
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <fogl/context.hpp>
 #include <fogl/flags.hpp>
 #include <fogl/gl.hpp>
 
@@ -11,6 +12,15 @@ namespace fogl {
   template<typename child, typename ref, typename cref> struct obj {
   private:
     ref ref_;
+#ifdef FOGL_EGL_CONTEXT_TRACKING
+    context_handle context_ = nullptr;
+#endif
+    /// Record the current context as the one which created the object.
+    void record_context() {
+#ifdef FOGL_EGL_CONTEXT_TRACKING
+      context_ = current_context();
+#endif
+    }
   protected:
     /// Invalidate the id.
     obj<child, ref, cref> &operator=(std::nullptr_t) {
@@ -20,7 +30,10 @@ namespace fogl {
     obj<child, ref, cref>& operator=(const obj<child, ref, cref>&) = delete;
     obj<child, ref, cref>& operator=(obj<child, ref, cref>&& o) {
       reinterpret_cast<child*>(this)->destroy();
-      id() = o.id();
+      ref_.id(o.id());
+#ifdef FOGL_EGL_CONTEXT_TRACKING
+      context_ = o.context_;
+#endif
       o.invalidate();
       return *this;
     }
@@ -29,9 +42,13 @@ namespace fogl {
     }
     /// Create from a given id.
     obj(from_id, GLuint id) : ref_(from_id(), id) {
+      record_context();
     }
     obj(const obj<child, ref, cref>&) = delete;
     obj(obj<child, ref, cref>&& o) : ref_(from_id(), o.id()) {
+#ifdef FOGL_EGL_CONTEXT_TRACKING
+      context_ = o.context_;
+#endif
       o.invalidate();
     }
     ~obj() {
@@ -46,6 +63,15 @@ namespace fogl {
     void id(GLuint id) {
       reinterpret_cast<child*>(this)->destroy();
       ref_.id(id);
+      record_context();
+    }
+    /// The context which created the object, always null without FOGL_EGL_CONTEXT_TRACKING.
+    context_handle context() const {
+#ifdef FOGL_EGL_CONTEXT_TRACKING
+      return context_;
+#else
+      return nullptr;
+#endif
     }
     /// Invalidate withour of destroying.
     void invalidate() {
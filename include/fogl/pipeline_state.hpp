@@ -0,0 +1,358 @@
+#pragma once
+
+#include <fogl/program.hpp>
+#include <fogl/flags.hpp>
+#include <fogl/check.hpp>
+#include <fogl/error.hpp>
+#include <fogl/exception.hpp>
+#include <fogl/gl.hpp>
+
+#include <cstring>
+#include <cstdint>
+#include <cstddef>
+#include <mutex>
+#include <unordered_set>
+
+namespace fogl {
+
+  /// Blend state.
+  struct blend_state {
+    GLboolean enabled = GL_FALSE;
+    GLenum src_rgb = GL_ONE;
+    GLenum dst_rgb = GL_ZERO;
+    GLenum src_alpha = GL_ONE;
+    GLenum dst_alpha = GL_ZERO;
+    GLenum equation_rgb = GL_FUNC_ADD;
+    GLenum equation_alpha = GL_FUNC_ADD;
+    GLfloat color[4] = {0.f, 0.f, 0.f, 0.f};
+  };
+
+  /// Depth state.
+  struct depth_state {
+    GLboolean enabled = GL_FALSE;
+    GLenum func = GL_LESS;
+    GLboolean write = GL_TRUE;
+  };
+
+  /// Stencil state, the same for front and back faces.
+  struct stencil_state {
+    GLboolean enabled = GL_FALSE;
+    GLenum func = GL_ALWAYS;
+    GLint ref = 0;
+    GLuint read_mask = ~0u;
+    GLuint write_mask = ~0u;
+    GLenum fail = GL_KEEP;
+    GLenum depth_fail = GL_KEEP;
+    GLenum pass = GL_KEEP;
+  };
+
+  /// Face culling state.
+  struct cull_state {
+    GLboolean enabled = GL_FALSE;
+    GLenum face = GL_BACK;
+    GLenum front_face = GL_CCW;
+  };
+
+  /// A rectangle of the viewport or the scissor box.
+  struct rect_state {
+    GLint x = 0;
+    GLint y = 0;
+    GLsizei width = 0;
+    GLsizei height = 0;
+  };
+
+  /// Scissor state.
+  struct scissor_state {
+    GLboolean enabled = GL_FALSE;
+    rect_state box;
+  };
+
+  /// Fixed function state, which is set by a pipeline_state.
+  struct state_block {
+    blend_state blend;
+    depth_state depth;
+    stencil_state stencil;
+    cull_state cull;
+    scissor_state scissor;
+    rect_state viewport;
+    GLboolean color_mask[4] = {GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE};
+    /// Enable blending with the given factors for color and alpha.
+    state_block &blend_func(GLenum src, GLenum dst) {
+      blend.enabled = GL_TRUE;
+      blend.src_rgb = blend.src_alpha = src;
+      blend.dst_rgb = blend.dst_alpha = dst;
+      return *this;
+    }
+    /// Enable the depth test.
+    state_block &depth_test(GLenum func = GL_LESS, GLboolean write = GL_TRUE) {
+      depth.enabled = GL_TRUE;
+      depth.func = func;
+      depth.write = write;
+      return *this;
+    }
+    /// Enable face culling.
+    state_block &cull_face(GLenum face = GL_BACK, GLenum front_face = GL_CCW) {
+      cull.enabled = GL_TRUE;
+      cull.face = face;
+      cull.front_face = front_face;
+      return *this;
+    }
+    /// Set the viewport.
+    state_block &view(GLint x, GLint y, GLsizei width, GLsizei height) {
+      viewport.x = x;
+      viewport.y = y;
+      viewport.width = width;
+      viewport.height = height;
+      return *this;
+    }
+    /// Enable the scissor test.
+    state_block &scissor_box(GLint x, GLint y, GLsizei width, GLsizei height) {
+      scissor.enabled = GL_TRUE;
+      scissor.box.x = x;
+      scissor.box.y = y;
+      scissor.box.width = width;
+      scissor.box.height = height;
+      return *this;
+    }
+    /// Set the color mask.
+    state_block &mask_color(GLboolean r, GLboolean g, GLboolean b, GLboolean a) {
+      color_mask[0] = r;
+      color_mask[1] = g;
+      color_mask[2] = b;
+      color_mask[3] = a;
+      return *this;
+    }
+  };
+
+  static inline bool operator==(const blend_state &a, const blend_state &b) {
+    return a.enabled == b.enabled && a.src_rgb == b.src_rgb && a.dst_rgb == b.dst_rgb && a.src_alpha == b.src_alpha && a.dst_alpha == b.dst_alpha
+      && a.equation_rgb == b.equation_rgb && a.equation_alpha == b.equation_alpha && std::memcmp(a.color, b.color, sizeof(a.color)) == 0;
+  }
+  static inline bool operator==(const depth_state &a, const depth_state &b) {
+    return a.enabled == b.enabled && a.func == b.func && a.write == b.write;
+  }
+  static inline bool operator==(const stencil_state &a, const stencil_state &b) {
+    return a.enabled == b.enabled && a.func == b.func && a.ref == b.ref && a.read_mask == b.read_mask && a.write_mask == b.write_mask
+      && a.fail == b.fail && a.depth_fail == b.depth_fail && a.pass == b.pass;
+  }
+  static inline bool operator==(const cull_state &a, const cull_state &b) {
+    return a.enabled == b.enabled && a.face == b.face && a.front_face == b.front_face;
+  }
+  static inline bool operator==(const rect_state &a, const rect_state &b) {
+    return a.x == b.x && a.y == b.y && a.width == b.width && a.height == b.height;
+  }
+  static inline bool operator==(const scissor_state &a, const scissor_state &b) {
+    return a.enabled == b.enabled && a.box == b.box;
+  }
+  static inline bool operator==(const state_block &a, const state_block &b) {
+    return a.blend == b.blend && a.depth == b.depth && a.stencil == b.stencil && a.cull == b.cull && a.scissor == b.scissor
+      && a.viewport == b.viewport && std::memcmp(a.color_mask, b.color_mask, sizeof(a.color_mask)) == 0;
+  }
+
+  /// Hash of a state block.
+  static inline size_t hash_value(const state_block &s) {
+    uint64_t h = 14695981039346656037ull;
+    auto mix = [&h](uint64_t v) {
+      h = (h ^ v) * 1099511628211ull;
+    };
+    auto mix_float = [&mix](GLfloat f) {
+      uint32_t bits;
+      std::memcpy(&bits, &f, sizeof(bits));
+      mix(bits);
+    };
+    mix(s.blend.enabled); mix(s.blend.src_rgb); mix(s.blend.dst_rgb); mix(s.blend.src_alpha); mix(s.blend.dst_alpha);
+    mix(s.blend.equation_rgb); mix(s.blend.equation_alpha);
+    for (GLfloat c : s.blend.color)
+      mix_float(c);
+    mix(s.depth.enabled); mix(s.depth.func); mix(s.depth.write);
+    mix(s.stencil.enabled); mix(s.stencil.func); mix(uint32_t(s.stencil.ref)); mix(s.stencil.read_mask); mix(s.stencil.write_mask);
+    mix(s.stencil.fail); mix(s.stencil.depth_fail); mix(s.stencil.pass);
+    mix(s.cull.enabled); mix(s.cull.face); mix(s.cull.front_face);
+    mix(s.scissor.enabled); mix(uint32_t(s.scissor.box.x)); mix(uint32_t(s.scissor.box.y)); mix(uint32_t(s.scissor.box.width)); mix(uint32_t(s.scissor.box.height));
+    mix(uint32_t(s.viewport.x)); mix(uint32_t(s.viewport.y)); mix(uint32_t(s.viewport.width)); mix(uint32_t(s.viewport.height));
+    for (GLboolean m : s.color_mask)
+      mix(m);
+    return size_t(h);
+  }
+
+  /// Immutable pair of a state block and a program. Only interned instances exist, so equal states have the same address.
+  struct pipeline_state {
+  private:
+    state_block state_;
+    GLuint program_;
+    size_t hash_;
+    struct hasher {
+      size_t operator()(const pipeline_state &p) const {
+        return p.hash_;
+      }
+    };
+    pipeline_state(const state_block &state, GLuint program) : state_(state), program_(program), hash_(hash_value(state) * 31 + program) {
+    }
+  public:
+    /// The fixed function state.
+    const state_block &state() const {
+      return state_;
+    }
+    /// The program.
+    program_cref program() const {
+      return program_cref(from_id(), program_);
+    }
+    /// The hash.
+    size_t hash() const {
+      return hash_;
+    }
+    bool operator==(const pipeline_state &o) const {
+      return program_ == o.program_ && state_ == o.state_;
+    }
+    /// The interned pipeline state of a state block and a program. Interned states live until the end of the program.
+    static const pipeline_state &intern(const state_block &state, program_cref program) {
+      static std::mutex mutex;
+      static std::unordered_set<pipeline_state, hasher> states;
+      std::lock_guard<std::mutex> lock(mutex);
+      return *states.insert(pipeline_state(state, program.id())).first;
+    }
+  };
+
+  /// Counters of a pipeline_tracker.
+  struct pipeline_stats {
+    /// Number of applied pipeline states.
+    size_t applied = 0;
+    /// Number of applications which were skipped because the state was already applied.
+    size_t unchanged = 0;
+    /// Number of issued GL calls.
+    size_t calls = 0;
+    /// Number of GL calls which were not needed.
+    size_t calls_avoided = 0;
+  };
+
+  /// Applies pipeline states with the minimum number of GL calls, by remembering the last applied state of a context.
+  struct pipeline_tracker {
+  private:
+    /// The last applied pipeline state, or null.
+    const pipeline_state *current_;
+    /// The state of the context, valid if known_.
+    state_block state_;
+    GLuint program_;
+    bool known_;
+    pipeline_stats stats_;
+    /// Issue a call if the state differs or is unknown.
+    template<typename f> void set(bool same, f call) {
+      if (same && known_) {
+        ++stats_.calls_avoided;
+      } else {
+        call();
+        ++stats_.calls;
+      }
+    }
+    /// Number of calls which apply() considers for a state with known context state.
+    static size_t tracked_calls(const state_block &s) {
+      return 10 + (s.blend.enabled ? 3 : 0) + (s.depth.enabled ? 1 : 0) + (s.stencil.enabled ? 2 : 0) + (s.cull.enabled ? 2 : 0) + (s.scissor.enabled ? 1 : 0);
+    }
+    void enable(GLenum cap, GLboolean current, GLboolean wanted) {
+      set(current == wanted, [&] {
+        if (wanted)
+          glEnable(cap);
+        else
+          glDisable(cap);
+      });
+    }
+  public:
+    /// Apply a pipeline state. State which is only used by disabled tests is left alone, unless the context state is unknown.
+    /// Write masks are always applied, since they also affect glClear.
+    void apply(const pipeline_state &p) {
+      ++stats_.applied;
+      if (&p == current_) {
+        ++stats_.unchanged;
+        stats_.calls_avoided += tracked_calls(p.state());
+        return;
+      }
+      const state_block &s = p.state();
+      state_block &c = state_;
+      GLuint program = p.program().id();
+      set(program == program_, [&] { glUseProgram(program); });
+
+      enable(GL_BLEND, c.blend.enabled, s.blend.enabled);
+      if (s.blend.enabled || !known_) {
+        set(c.blend.src_rgb == s.blend.src_rgb && c.blend.dst_rgb == s.blend.dst_rgb && c.blend.src_alpha == s.blend.src_alpha && c.blend.dst_alpha == s.blend.dst_alpha,
+          [&] { glBlendFuncSeparate(s.blend.src_rgb, s.blend.dst_rgb, s.blend.src_alpha, s.blend.dst_alpha); });
+        set(c.blend.equation_rgb == s.blend.equation_rgb && c.blend.equation_alpha == s.blend.equation_alpha,
+          [&] { glBlendEquationSeparate(s.blend.equation_rgb, s.blend.equation_alpha); });
+        set(std::memcmp(c.blend.color, s.blend.color, sizeof(c.blend.color)) == 0,
+          [&] { glBlendColor(s.blend.color[0], s.blend.color[1], s.blend.color[2], s.blend.color[3]); });
+        GLboolean enabled = c.blend.enabled;
+        c.blend = s.blend;
+        c.blend.enabled = enabled;
+      }
+      c.blend.enabled = s.blend.enabled;
+
+      enable(GL_DEPTH_TEST, c.depth.enabled, s.depth.enabled);
+      if (s.depth.enabled || !known_) {
+        set(c.depth.func == s.depth.func, [&] { glDepthFunc(s.depth.func); });
+        c.depth.func = s.depth.func;
+      }
+      c.depth.enabled = s.depth.enabled;
+      // The write mask also applies to glClear, so it is set even if the test is disabled.
+      set(c.depth.write == s.depth.write, [&] { glDepthMask(s.depth.write); });
+      c.depth.write = s.depth.write;
+
+      enable(GL_STENCIL_TEST, c.stencil.enabled, s.stencil.enabled);
+      if (s.stencil.enabled || !known_) {
+        set(c.stencil.func == s.stencil.func && c.stencil.ref == s.stencil.ref && c.stencil.read_mask == s.stencil.read_mask,
+          [&] { glStencilFunc(s.stencil.func, s.stencil.ref, s.stencil.read_mask); });
+        set(c.stencil.fail == s.stencil.fail && c.stencil.depth_fail == s.stencil.depth_fail && c.stencil.pass == s.stencil.pass,
+          [&] { glStencilOp(s.stencil.fail, s.stencil.depth_fail, s.stencil.pass); });
+        GLuint write_mask = c.stencil.write_mask;
+        c.stencil = s.stencil;
+        c.stencil.write_mask = write_mask;
+      }
+      c.stencil.enabled = s.stencil.enabled;
+      set(c.stencil.write_mask == s.stencil.write_mask, [&] { glStencilMask(s.stencil.write_mask); });
+      c.stencil.write_mask = s.stencil.write_mask;
+
+      enable(GL_CULL_FACE, c.cull.enabled, s.cull.enabled);
+      if (s.cull.enabled || !known_) {
+        set(c.cull.face == s.cull.face, [&] { glCullFace(s.cull.face); });
+        set(c.cull.front_face == s.cull.front_face, [&] { glFrontFace(s.cull.front_face); });
+        c.cull = s.cull;
+      }
+      c.cull.enabled = s.cull.enabled;
+
+      enable(GL_SCISSOR_TEST, c.scissor.enabled, s.scissor.enabled);
+      if (s.scissor.enabled || !known_) {
+        set(c.scissor.box == s.scissor.box, [&] { glScissor(s.scissor.box.x, s.scissor.box.y, s.scissor.box.width, s.scissor.box.height); });
+        c.scissor = s.scissor;
+      }
+      c.scissor.enabled = s.scissor.enabled;
+
+      set(c.viewport == s.viewport, [&] { glViewport(s.viewport.x, s.viewport.y, s.viewport.width, s.viewport.height); });
+      set(std::memcmp(c.color_mask, s.color_mask, sizeof(c.color_mask)) == 0,
+        [&] { glColorMask(s.color_mask[0], s.color_mask[1], s.color_mask[2], s.color_mask[3]); });
+      c.viewport = s.viewport;
+      std::memcpy(c.color_mask, s.color_mask, sizeof(c.color_mask));
+
+      auto_check_error();
+      program_ = program;
+      current_ = &p;
+      known_ = true;
+    }
+    /// Forget the state of the context, after it was changed without the tracker. The next apply sets everything.
+    void invalidate() {
+      current_ = nullptr;
+      known_ = false;
+    }
+    /// The counters since the last end of frame.
+    const pipeline_stats &stats() const {
+      return stats_;
+    }
+    /// End a frame. Returns the counters of the frame and resets them.
+    pipeline_stats end_frame() {
+      pipeline_stats stats = stats_;
+      stats_ = pipeline_stats();
+      return stats;
+    }
+    /// Construct with unknown context state.
+    pipeline_tracker() : current_(nullptr), program_(0), known_(false) {
+    }
+  };
+
+}
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <fogl/shader.hpp>
+#include <fogl/deletion_queue.hpp>
 #include <fogl/cref.hpp>
 #include <fogl/obj.hpp>
 #include <fogl/flags.hpp>
@@ -95,7 +96,8 @@ namespace fogl {
     void destroy() {
       if (this->is_null())
         return;
-      glDeleteProgram(id());
+      if (!defer_deletion(object_kind::program, id(), this->context()))
+        glDeleteProgram(id());
       invalidate();
     }
     /// Create the program
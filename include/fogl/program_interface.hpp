@@ -0,0 +1,266 @@
+#pragma once
+
+#include <fogl/program.hpp>
+#include <fogl/glsl.hpp>
+#include <fogl/cref.hpp>
+#include <fogl/flags.hpp>
+#include <fogl/check.hpp>
+#include <fogl/error.hpp>
+#include <fogl/exception.hpp>
+#include <fogl/gl.hpp>
+
+#include <cstddef>
+#include <cstring>
+#include <vector>
+
+namespace fogl {
+
+  /// Types of GLSL attributes and uniforms.
+  enum class glsl_type : GLenum {
+    float_ = GL_FLOAT,
+    vec2 = GL_FLOAT_VEC2,
+    vec3 = GL_FLOAT_VEC3,
+    vec4 = GL_FLOAT_VEC4,
+    int_ = GL_INT,
+    ivec2 = GL_INT_VEC2,
+    ivec3 = GL_INT_VEC3,
+    ivec4 = GL_INT_VEC4,
+    bool_ = GL_BOOL,
+    bvec2 = GL_BOOL_VEC2,
+    bvec3 = GL_BOOL_VEC3,
+    bvec4 = GL_BOOL_VEC4,
+    mat2 = GL_FLOAT_MAT2,
+    mat3 = GL_FLOAT_MAT3,
+    mat4 = GL_FLOAT_MAT4,
+    sampler2D = GL_SAMPLER_2D,
+    samplerCube = GL_SAMPLER_CUBE,
+  };
+
+  /// The GLSL spelling of a type.
+  static inline constexpr const char *glsl_type_name(glsl_type t) {
+    switch (t) {
+      case glsl_type::float_: return "float";
+      case glsl_type::vec2: return "vec2";
+      case glsl_type::vec3: return "vec3";
+      case glsl_type::vec4: return "vec4";
+      case glsl_type::int_: return "int";
+      case glsl_type::ivec2: return "ivec2";
+      case glsl_type::ivec3: return "ivec3";
+      case glsl_type::ivec4: return "ivec4";
+      case glsl_type::bool_: return "bool";
+      case glsl_type::bvec2: return "bvec2";
+      case glsl_type::bvec3: return "bvec3";
+      case glsl_type::bvec4: return "bvec4";
+      case glsl_type::mat2: return "mat2";
+      case glsl_type::mat3: return "mat3";
+      case glsl_type::mat4: return "mat4";
+      case glsl_type::sampler2D: return "sampler2D";
+      case glsl_type::samplerCube: return "samplerCube";
+    }
+    return "";
+  }
+
+  static inline constexpr size_t glsl_length(const char *s) {
+    size_t n = 0;
+    while (s[n])
+      ++n;
+    return n;
+  }
+
+/// Declare a GLSL variable of a program interface as a type with the given name.
+/// The type is a glsl_type, e.g. vec3, mat4 or float_.
+#define FOGL_GLSL_VARIABLE(type_, name_) \
+  struct name_ { \
+    static constexpr ::fogl::glsl_type type() { return ::fogl::glsl_type::type_; } \
+    static constexpr const char *name() { return #name_; } \
+  }
+
+  /// A list of variables declared with FOGL_GLSL_VARIABLE.
+  template<typename... vars> struct glsl_variables {
+  };
+
+  /// Sets a uniform of a given type.
+  template<glsl_type t> struct uniform_setter;
+  template<> struct uniform_setter<glsl_type::float_> {
+    static void set(GLint l, GLfloat x) { glUniform1f(l, x); }
+  };
+  template<> struct uniform_setter<glsl_type::vec2> {
+    static void set(GLint l, GLfloat x, GLfloat y) { glUniform2f(l, x, y); }
+    static void set(GLint l, const GLfloat *v) { glUniform2fv(l, 1, v); }
+  };
+  template<> struct uniform_setter<glsl_type::vec3> {
+    static void set(GLint l, GLfloat x, GLfloat y, GLfloat z) { glUniform3f(l, x, y, z); }
+    static void set(GLint l, const GLfloat *v) { glUniform3fv(l, 1, v); }
+  };
+  template<> struct uniform_setter<glsl_type::vec4> {
+    static void set(GLint l, GLfloat x, GLfloat y, GLfloat z, GLfloat w) { glUniform4f(l, x, y, z, w); }
+    static void set(GLint l, const GLfloat *v) { glUniform4fv(l, 1, v); }
+  };
+  template<> struct uniform_setter<glsl_type::int_> {
+    static void set(GLint l, GLint x) { glUniform1i(l, x); }
+  };
+  template<> struct uniform_setter<glsl_type::ivec2> {
+    static void set(GLint l, const GLint *v) { glUniform2iv(l, 1, v); }
+  };
+  template<> struct uniform_setter<glsl_type::ivec3> {
+    static void set(GLint l, const GLint *v) { glUniform3iv(l, 1, v); }
+  };
+  template<> struct uniform_setter<glsl_type::ivec4> {
+    static void set(GLint l, const GLint *v) { glUniform4iv(l, 1, v); }
+  };
+  template<> struct uniform_setter<glsl_type::bool_> {
+    static void set(GLint l, bool x) { glUniform1i(l, x ? 1 : 0); }
+  };
+  template<> struct uniform_setter<glsl_type::bvec2> {
+    static void set(GLint l, const GLint *v) { glUniform2iv(l, 1, v); }
+  };
+  template<> struct uniform_setter<glsl_type::bvec3> {
+    static void set(GLint l, const GLint *v) { glUniform3iv(l, 1, v); }
+  };
+  template<> struct uniform_setter<glsl_type::bvec4> {
+    static void set(GLint l, const GLint *v) { glUniform4iv(l, 1, v); }
+  };
+  template<> struct uniform_setter<glsl_type::mat2> {
+    static void set(GLint l, const GLfloat *m) { glUniformMatrix2fv(l, 1, GL_FALSE, m); }
+  };
+  template<> struct uniform_setter<glsl_type::mat3> {
+    static void set(GLint l, const GLfloat *m) { glUniformMatrix3fv(l, 1, GL_FALSE, m); }
+  };
+  template<> struct uniform_setter<glsl_type::mat4> {
+    static void set(GLint l, const GLfloat *m) { glUniformMatrix4fv(l, 1, GL_FALSE, m); }
+  };
+  template<> struct uniform_setter<glsl_type::sampler2D> {
+    static void set(GLint l, GLint unit) { glUniform1i(l, unit); }
+  };
+  template<> struct uniform_setter<glsl_type::samplerCube> {
+    static void set(GLint l, GLint unit) { glUniform1i(l, unit); }
+  };
+
+  /// Index of a variable in a list, or the length of the list if it is not contained.
+  template<typename var, typename... vars> struct glsl_index_of;
+  template<typename var> struct glsl_index_of<var> {
+    static constexpr size_t value = 0;
+  };
+  template<typename var, typename... rest> struct glsl_index_of<var, var, rest...> {
+    static constexpr size_t value = 0;
+  };
+  template<typename var, typename first, typename... rest> struct glsl_index_of<var, first, rest...> {
+    static constexpr size_t value = 1 + glsl_index_of<var, rest...>::value;
+  };
+
+  /// Exception which is thrown if an active variable of a program has another type than declared in the interface.
+  struct interface_mismatch : exception {
+    const char *name;
+    GLenum declared;
+    GLenum actual;
+    interface_mismatch(const char *name, GLenum declared, GLenum actual) : name(name), declared(declared), actual(actual) {
+    }
+  };
+
+  /// Typed interface of a program: the attributes and uniforms with their GLSL types.
+  /// Locations are looked up and validated once by bind(), then accessed with compile time indices.
+  template<typename attributes, typename uniforms> struct program_interface;
+  template<typename... as, typename... us> struct program_interface<glsl_variables<as...>, glsl_variables<us...>> {
+  private:
+    GLint attribute_locations_[sizeof...(as) + 1];
+    GLint uniform_locations_[sizeof...(us) + 1];
+    /// Type of the active attribute or uniform with a name, 0 if not active.
+    static GLenum active_type(GLuint program, bool attribute, const char *name) {
+      GLint count = 0, max_length = 0;
+      glGetProgramiv(program, attribute ? GL_ACTIVE_ATTRIBUTES : GL_ACTIVE_UNIFORMS, &count);
+      glGetProgramiv(program, attribute ? GL_ACTIVE_ATTRIBUTE_MAX_LENGTH : GL_ACTIVE_UNIFORM_MAX_LENGTH, &max_length);
+      std::vector<char> buf(max_length + 1);
+      for (GLint i = 0; i < count; ++i) {
+        GLint size = 0;
+        GLenum type = 0;
+        if (attribute)
+          glGetActiveAttrib(program, i, max_length + 1, nullptr, &size, &type, &buf[0]);
+        else
+          glGetActiveUniform(program, i, max_length + 1, nullptr, &size, &type, &buf[0]);
+        if (std::strcmp(&buf[0], name) == 0)
+          return type;
+      }
+      return 0;
+    }
+    /// Look up and validate one variable.
+    template<typename var> static GLint locate(program_cref program, bool attribute) {
+      GLint location = attribute ? glGetAttribLocation(program.id(), var::name()) : glGetUniformLocation(program.id(), var::name());
+      if (location < 0)
+        return -1;
+      GLenum type = active_type(program.id(), attribute, var::name());
+      if (type != 0 && type != GLenum(var::type()))
+        throw interface_mismatch(var::name(), GLenum(var::type()), type);
+      return location;
+    }
+    template<size_t n, typename... vars> static constexpr void declare(glsl_source<n> &out, const char *qualifier) {
+      const char *names[] = {"", vars::name()...};
+      const char *types[] = {"", glsl_type_name(vars::type())...};
+      for (size_t i = 1; i < sizeof...(vars) + 1; ++i) {
+        out.append(qualifier, glsl_length(qualifier));
+        out.push_back(' ');
+        out.append(types[i], glsl_length(types[i]));
+        out.push_back(' ');
+        out.append(names[i], glsl_length(names[i]));
+        out.append(";\n", 2);
+      }
+    }
+  public:
+    /// Number of attributes.
+    static constexpr size_t attribute_count = sizeof...(as);
+    /// Number of uniforms.
+    static constexpr size_t uniform_count = sizeof...(us);
+    /// GLSL declarations of the attributes, to be composed into the vertex shader source.
+    static constexpr glsl_source<glsl_sum(glsl_length(as::name()) + 24 ...)> attribute_declarations() {
+      glsl_source<glsl_sum(glsl_length(as::name()) + 24 ...)> out;
+      declare<glsl_sum(glsl_length(as::name()) + 24 ...), as...>(out, "attribute");
+      return out;
+    }
+    /// GLSL declarations of the uniforms, to be composed into shader sources.
+    /// They carry no precision qualifier, so a uniform used by both stages needs the same default precision in each.
+    static constexpr glsl_source<glsl_sum(glsl_length(us::name()) + 24 ...)> uniform_declarations() {
+      glsl_source<glsl_sum(glsl_length(us::name()) + 24 ...)> out;
+      declare<glsl_sum(glsl_length(us::name()) + 24 ...), us...>(out, "uniform");
+      return out;
+    }
+    /// Look up the locations in a linked program and check the types of the active variables.
+    /// Variables which are not active get location -1. Throws interface_mismatch on a type mismatch.
+    void bind(program_cref program) {
+      program.auto_check_not_null();
+      GLint attributes[] = {-1, locate<as>(program, true)...};
+      GLint uniforms[] = {-1, locate<us>(program, false)...};
+      std::memcpy(attribute_locations_, attributes + 1, sizeof(GLint) * sizeof...(as));
+      std::memcpy(uniform_locations_, uniforms + 1, sizeof(GLint) * sizeof...(us));
+      auto_check_error();
+    }
+    /// Location of an attribute, -1 if it is not active.
+    template<typename var> GLint attribute() const {
+      static_assert(glsl_index_of<var, as...>::value < sizeof...(as), "not an attribute of the interface");
+      return attribute_locations_[glsl_index_of<var, as...>::value];
+    }
+    /// Location of a uniform, -1 if it is not active.
+    template<typename var> GLint uniform() const {
+      static_assert(glsl_index_of<var, us...>::value < sizeof...(us), "not a uniform of the interface");
+      return uniform_locations_[glsl_index_of<var, us...>::value];
+    }
+    /// Set a uniform of the program in use, with arguments matching its GLSL type.
+    template<typename var, typename... args> void set(args... a) const {
+      GLint location = uniform<var>();
+      if (location < 0)
+        return;
+      uniform_setter<var::type()>::set(location, a...);
+      auto_check_error();
+    }
+    /// Construct with all locations -1.
+    program_interface() {
+      for (GLint &l : attribute_locations_)
+        l = -1;
+      for (GLint &l : uniform_locations_)
+        l = -1;
+    }
+    /// Construct and bind to a linked program.
+    program_interface(program_cref program) : program_interface() {
+      bind(program);
+    }
+  };
+
+}
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <fogl/glsl.hpp>
+#include <fogl/deletion_queue.hpp>
 #include <fogl/cref.hpp>
 #include <fogl/obj.hpp>
 #include <fogl/flags.hpp>
@@ -9,6 +11,7 @@
 #include <fogl/gl.hpp>
 
 #include <initializer_list>
+#include <cstddef>
 #include <string>
 #include <vector>
 #include <cassert>
@@ -48,17 +51,23 @@ namespace fogl {
 
   /// C++ wrapper of a reference to a mutable opengl shader.
   template<GLenum type> struct shader_ref : shader_cref<type> {
-    /// Set the shader source.
+    /// Set the shader source, concatenated from several strings.
     void src(std::initializer_list<const char *> src) const {
       this->auto_check_not_null();
-      std::string csrc;
-      for (const char *s : src) {
-        csrc += s;
-      };
-      const char *s = csrc.c_str();
-      glShaderSource(this->id(), 1, &s, NULL);
+      // Older GLES2 headers take const GLchar**, which a const char *const * does not convert to.
+      glShaderSource(this->id(), GLsizei(src.size()), const_cast<const GLchar**>(src.begin()), NULL);
+      auto_check_error();
+    }
+    /// Set the shader source.
+    void src(const char *src) const {
+      this->auto_check_not_null();
+      glShaderSource(this->id(), 1, &src, NULL);
       auto_check_error();
     }
+    /// Set the shader source composed at compile time.
+    template<size_t n> void src(const glsl_source<n> &src) const {
+      this->src(src.c_str());
+    }
     /// Compile the shader.
     void compile() const {
       this->auto_check_not_null();
@@ -82,7 +91,8 @@ namespace fogl {
     void destroy() {
       if (!*this)
         return;
-      glDeleteShader(this->id());
+      if (!defer_deletion(object_kind::shader, this->id(), this->context()))
+        glDeleteShader(this->id());
       this->invalidate();
     }
     /// Create the shader
@@ -90,16 +100,13 @@ namespace fogl {
       this->id(glCreateShader(type));
       auto_check_error();
     }
-    /// Set the shader source.
+    /// Set the shader source, concatenated from several strings.
     void src(std::initializer_list<const char *> src) {
-      assert(!this->is_null());
-      std::string csrc;
-      for (const char *s : src) {
-        csrc += s;
-      };
-      const char *s = csrc.c_str();
-      glShaderSource(this->id(), 1, &s, NULL);
-      assert(glGetError() == 0);
+      (*this)->src(src);
+    }
+    /// Set the shader source composed at compile time.
+    template<size_t n> void src(const glsl_source<n> &src) {
+      (*this)->src(src);
     }
     /// Compile the shader.
     void compile() {
@@ -123,6 +130,12 @@ namespace fogl {
       (*this)->src(src);
       (*this)->compile();
     }
+    /// Construct with opengl shader created from source composed at compile time
+    template<size_t n> shader(const glsl_source<n> &src) {
+      create();
+      (*this)->src(src);
+      (*this)->compile();
+    }
   };
 
   /// C++ wrapper of an opengl vertex shader.
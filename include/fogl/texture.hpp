@@ -1,5 +1,7 @@
 #pragma once
 
+#include <fogl/deletion_queue.hpp>
+#include <fogl/id_pool.hpp>
 #include <fogl/cref.hpp>
 #include <fogl/obj.hpp>
 #include <fogl/flags.hpp>
@@ -120,13 +122,17 @@ namespace fogl {
       if (this->is_null())
         return;
       GLuint id = this->id();
-      glDeleteTextures(1, &id);
+      if (!defer_deletion(object_kind::texture, id, this->context()))
+        glDeleteTextures(1, &id);
       this->invalidate();
     }
-    /// Create the texture
+    /// Create the texture, taking the name from the current id pool if there is one.
     void create() {
-      GLuint id;
-      glGenTextures(1, &id);
+      GLuint id = 0;
+      if (id_pool *pool = id_pool::current())
+        id = pool->gen_texture();
+      else
+        glGenTextures(1, &id);
       this->id(id);
     }
     /// Construct with invalid id.
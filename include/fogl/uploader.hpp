@@ -0,0 +1,262 @@
+#pragma once
+
+#include <fogl/texture.hpp>
+#include <fogl/buffer.hpp>
+#include <fogl/extension.hpp>
+#include <fogl/flags.hpp>
+#include <fogl/check.hpp>
+#include <fogl/error.hpp>
+#include <fogl/exception.hpp>
+#include <fogl/gl.hpp>
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+#include <cassert>
+
+namespace fogl {
+
+  /// Exception which is thrown if an EGL call fails.
+  struct egl_error : exception {
+    EGLint code;
+    egl_error(EGLint code) : code(code) {
+    }
+  };
+
+  /// Result of an upload. Owned by the render thread once it is ready.
+  template<typename object> struct upload {
+  private:
+    object object_;
+    std::exception_ptr error_;
+    std::atomic<bool> ready_;
+    friend struct uploader;
+  public:
+    /// Whether the upload is finished and visible to the render thread.
+    bool ready() const {
+      return ready_;
+    }
+    /// Whether the upload job threw an exception.
+    bool failed() const {
+      return ready() && error_ != nullptr;
+    }
+    /// The uploaded object. Rethrows the exception of the upload job, if any.
+    object &get() {
+      assert(ready());
+      if (error_)
+        std::rethrow_exception(error_);
+      return object_;
+    }
+    /// Construct not ready.
+    upload() : ready_(false) {
+    }
+  };
+
+  /// Runs uploads on a worker thread with a second context which shares objects with the render context.
+  /// Finished uploads are handed over with an EGL fence if EGL_KHR_fence_sync is supported, otherwise with glFinish.
+  struct uploader {
+  private:
+    /// A finished job, waiting for its fence. finish is called with the error of a failed wait, or null.
+    struct completion {
+      EGLSyncKHR sync;
+      std::function<void(std::exception_ptr)> finish;
+    };
+    EGLDisplay display_;
+    EGLContext context_;
+    EGLSurface surface_;
+    PFNEGLCREATESYNCKHRPROC create_sync_;
+    PFNEGLCLIENTWAITSYNCKHRPROC client_wait_sync_;
+    PFNEGLDESTROYSYNCKHRPROC destroy_sync_;
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::deque<std::function<void()>> jobs_;
+    std::vector<completion> completions_;
+    bool stop_;
+    /// Set by the worker thread if its context cannot be made current. Every job then fails with it.
+    std::exception_ptr context_error_;
+    std::thread thread_;
+    /// Body of the worker thread.
+    void run() {
+      if (!eglMakeCurrent(display_, surface_, surface_, context_))
+        context_error_ = std::make_exception_ptr(egl_error(eglGetError()));
+      for (;;) {
+        std::function<void()> job;
+        {
+          std::unique_lock<std::mutex> lock(mutex_);
+          wake_.wait(lock, [this] { return stop_ || !jobs_.empty(); });
+          if (jobs_.empty())
+            break;
+          job = std::move(jobs_.front());
+          jobs_.pop_front();
+        }
+        job();
+      }
+      eglMakeCurrent(display_, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+      eglReleaseThread();
+    }
+    /// Hand a finished job over to the render thread. Called on the worker thread.
+    void hand_over(std::function<void(std::exception_ptr)> finish) {
+      completion c;
+      c.sync = EGL_NO_SYNC_KHR;
+      if (!context_error_) {
+        if (create_sync_)
+          c.sync = create_sync_(display_, EGL_SYNC_FENCE_KHR, nullptr);
+        if (c.sync != EGL_NO_SYNC_KHR)
+          glFlush();
+        else
+          glFinish();
+      }
+      c.finish = std::move(finish);
+      std::lock_guard<std::mutex> lock(mutex_);
+      completions_.push_back(std::move(c));
+    }
+  public:
+    /// Create the shared context and start the worker thread.
+    /// The config should support pbuffers unless the display supports EGL_KHR_surfaceless_context.
+    uploader(EGLDisplay display, EGLContext render_context, EGLConfig config) :
+        display_(display), context_(EGL_NO_CONTEXT), surface_(EGL_NO_SURFACE),
+        create_sync_(nullptr), client_wait_sync_(nullptr), destroy_sync_(nullptr), stop_(false) {
+      const EGLint context_attribs[] = {EGL_CONTEXT_CLIENT_VERSION, 2, EGL_NONE};
+      context_ = eglCreateContext(display_, config, render_context, context_attribs);
+      if (context_ == EGL_NO_CONTEXT)
+        throw egl_error(eglGetError());
+      if (!has_egl_extension(display_, "EGL_KHR_surfaceless_context")) {
+        const EGLint surface_attribs[] = {EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE};
+        surface_ = eglCreatePbufferSurface(display_, config, surface_attribs);
+        if (surface_ == EGL_NO_SURFACE) {
+          EGLint code = eglGetError();
+          eglDestroyContext(display_, context_);
+          throw egl_error(code);
+        }
+      }
+      if (has_egl_extension(display_, "EGL_KHR_fence_sync")) {
+        create_sync_ = proc_address<PFNEGLCREATESYNCKHRPROC>("eglCreateSyncKHR");
+        client_wait_sync_ = proc_address<PFNEGLCLIENTWAITSYNCKHRPROC>("eglClientWaitSyncKHR");
+        destroy_sync_ = proc_address<PFNEGLDESTROYSYNCKHRPROC>("eglDestroySyncKHR");
+        if (!create_sync_ || !client_wait_sync_ || !destroy_sync_)
+          create_sync_ = nullptr;
+      }
+      thread_ = std::thread([this] { run(); });
+    }
+    uploader(const uploader&) = delete;
+    uploader &operator=(const uploader&) = delete;
+    /// Finish the queued jobs and stop the worker thread. Uploads which were not polled yet never become ready.
+    ~uploader() {
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+      }
+      wake_.notify_one();
+      thread_.join();
+      for (completion &c : completions_)
+        if (c.sync != EGL_NO_SYNC_KHR)
+          destroy_sync_(display_, c.sync);
+      if (surface_ != EGL_NO_SURFACE)
+        eglDestroySurface(display_, surface_);
+      eglDestroyContext(display_, context_);
+    }
+    /// The shared context of the worker thread, e.g. for deletion_queue::share().
+    EGLContext context() const {
+      return context_;
+    }
+    /// Whether finished uploads are handed over with fences instead of glFinish.
+    bool fenced() const {
+      return create_sync_ != nullptr;
+    }
+    /// Run a job on the worker thread, which creates and fills an object.
+    /// done is called on the render thread by poll() once the upload is ready, also if it failed.
+    /// If the shared context could not be made current, the upload fails with an egl_error instead.
+    template<typename object> std::shared_ptr<upload<object>> submit(std::function<object()> job, std::function<void(upload<object>&)> done = nullptr) {
+      auto result = std::make_shared<upload<object>>();
+      auto work = [this, result, job, done] {
+        if (context_error_) {
+          result->error_ = context_error_;
+        } else {
+          try {
+            result->object_ = job();
+          } catch (...) {
+            result->error_ = std::current_exception();
+          }
+        }
+        hand_over([result, done](std::exception_ptr error) {
+          if (error && !result->error_)
+            result->error_ = error;
+          result->ready_ = true;
+          if (done)
+            done(*result);
+        });
+      };
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        jobs_.push_back(work);
+      }
+      wake_.notify_one();
+      return result;
+    }
+    /// Create a buffer and set its data on the worker thread.
+    template<GLenum type> std::shared_ptr<upload<buffer<type>>> upload_buffer(std::vector<unsigned char> data, GLenum usage = GL_STATIC_DRAW, std::function<void(upload<buffer<type>>&)> done = nullptr) {
+      auto shared = std::make_shared<std::vector<unsigned char>>(std::move(data));
+      return submit<buffer<type>>([shared, usage] {
+        buffer<type> buf;
+        buf.create();
+        buf->bind();
+        buf->data(shared->data(), shared->size(), usage);
+        return buf;
+      }, done);
+    }
+    /// Create a 2d texture and set its image on the worker thread. Uses linear filtering, with mipmaps if requested.
+    std::shared_ptr<upload<texture2d>> upload_texture2d(GLint internal_format, GLsizei width, GLsizei height, GLenum format, GLenum type, std::vector<unsigned char> pixels, bool mipmaps = false, std::function<void(upload<texture2d>&)> done = nullptr) {
+      auto shared = std::make_shared<std::vector<unsigned char>>(std::move(pixels));
+      return submit<texture2d>([=] {
+        texture2d tex;
+        tex.create();
+        tex->bind();
+        tex->img2d(0, internal_format, width, height, format, type, shared->data());
+        tex->mag_filter(GL_LINEAR);
+        if (mipmaps) {
+          tex->gen_mipmaps();
+          tex->min_filter(GL_LINEAR_MIPMAP_LINEAR);
+        } else {
+          tex->min_filter(GL_LINEAR);
+        }
+        return tex;
+      }, done);
+    }
+    /// Mark the uploads whose fences are signaled as ready and call their completion callbacks.
+    /// An upload whose fence cannot be waited for becomes ready as failed with an egl_error.
+    /// Call regularly on the render thread. Returns the number of uploads which became ready.
+    size_t poll() {
+      std::vector<std::pair<completion, std::exception_ptr>> done;
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::vector<completion> pending;
+        for (completion &c : completions_) {
+          EGLint status = c.sync == EGL_NO_SYNC_KHR ? EGL_CONDITION_SATISFIED_KHR : client_wait_sync_(display_, c.sync, 0, 0);
+          if (status == EGL_CONDITION_SATISFIED_KHR)
+            done.emplace_back(std::move(c), nullptr);
+          else if (status == EGL_FALSE)
+            done.emplace_back(std::move(c), std::make_exception_ptr(egl_error(eglGetError())));
+          else
+            pending.push_back(std::move(c));
+        }
+        completions_.swap(pending);
+      }
+      for (auto &d : done) {
+        if (d.first.sync != EGL_NO_SYNC_KHR)
+          destroy_sync_(display_, d.first.sync);
+        d.first.finish(d.second);
+      }
+      return done.size();
+    }
+  };
+
+}
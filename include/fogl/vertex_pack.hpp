@@ -0,0 +1,280 @@
+#pragma once
+
+#include <fogl/buffer.hpp>
+#include <fogl/flags.hpp>
+#include <fogl/check.hpp>
+#include <fogl/error.hpp>
+#include <fogl/exception.hpp>
+#include <fogl/gl.hpp>
+
+#include <initializer_list>
+#include <vector>
+#include <cstring>
+#include <cmath>
+#include <cstdint>
+#include <cstddef>
+#include <cassert>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define FOGL_VERTEX_PACK_SSE2
+#if defined(__F16C__)
+#include <immintrin.h>
+#define FOGL_VERTEX_PACK_F16C
+#endif
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define FOGL_VERTEX_PACK_NEON
+#endif
+
+namespace fogl {
+
+  /// How a vertex attribute is stored in a packed vertex buffer.
+  enum class attribute_encoding {
+    /// 32 bit floats.
+    float32,
+    /// 16 bit floats, requires OES_vertex_half_float.
+    half_float,
+    /// Normalized signed shorts, for values in [-1, 1].
+    snorm16,
+    /// Normalized unsigned shorts, for values in [0, 1].
+    unorm16,
+    /// Normalized signed bytes, for values in [-1, 1].
+    snorm8,
+    /// Normalized unsigned bytes, for values in [0, 1].
+    unorm8,
+    /// Unit vectors with three components, octahedral encoded into two normalized signed shorts.
+    octahedral16,
+    /// Unit vectors with three components, octahedral encoded into two normalized signed bytes.
+    octahedral8,
+  };
+
+  /// GLSL function which decodes an octahedral encoded unit vector.
+  static constexpr const char *octahedral_decode_glsl =
+    "vec3 octahedral_decode(vec2 e) {\n"
+    "  vec3 v = vec3(e, 1.0 - abs(e.x) - abs(e.y));\n"
+    "  if (v.z < 0.0)\n"
+    "    v.xy = (1.0 - abs(v.yx)) * vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);\n"
+    "  return normalize(v);\n"
+    "}\n";
+
+  /// A stream of float attributes, one per vertex, with the components tightly packed.
+  struct attribute_stream {
+    /// The floats of the stream.
+    const GLfloat *data;
+    /// The number of components per vertex.
+    GLint components;
+    /// The encoding in the packed buffer.
+    attribute_encoding encoding;
+  };
+
+  /// Format of an attribute in a packed vertex buffer, as needed by glVertexAttribPointer.
+  struct attribute_format {
+    /// The number of components.
+    GLint size;
+    /// The component type.
+    GLenum type;
+    /// Whether integer components are normalized.
+    GLboolean normalized;
+    /// The offset in bytes from the start of the vertex.
+    GLsizei offset;
+    /// Set the attribute pointer of a location to this attribute of the bound array buffer.
+    void pointer(GLuint location, GLsizei stride) const {
+      glVertexAttribPointer(location, size, type, normalized, stride, reinterpret_cast<const GLvoid*>(static_cast<uintptr_t>(offset)));
+      auto_check_error();
+    }
+  };
+
+  /// Interleaved and quantized vertices.
+  struct packed_vertices {
+    /// The interleaved vertex data.
+    std::vector<unsigned char> data;
+    /// The size of one vertex in bytes.
+    GLsizei stride;
+    /// The format of each attribute, in the order of the streams.
+    std::vector<attribute_format> attributes;
+    /// Set the attribute pointers of the bound array buffer, one location per attribute.
+    void pointers(std::initializer_list<GLuint> locations) const {
+      assert(locations.size() <= attributes.size());
+      size_t i = 0;
+      for (GLuint location : locations)
+        attributes[i++].pointer(location, stride);
+    }
+    /// Upload into a new array buffer. Leaves the buffer bound.
+    array_buffer upload(GLenum usage = GL_STATIC_DRAW) const {
+      array_buffer buf;
+      buf.create();
+      buf->bind();
+      buf->data(data.data(), data.size(), usage);
+      return buf;
+    }
+  };
+
+  /// Convert a float to a half float, rounding to nearest even.
+  static inline uint16_t float_to_half(float f) {
+    uint32_t x;
+    std::memcpy(&x, &f, sizeof(x));
+    uint32_t sign = (x >> 16) & 0x8000u;
+    uint32_t abs = x & 0x7fffffffu;
+    if (abs >= 0x7f800000u)
+      return uint16_t(sign | 0x7c00u | (abs > 0x7f800000u ? 0x200u : 0u));
+    if (abs >= 0x477ff000u)
+      return uint16_t(sign | 0x7c00u);
+    if (abs < 0x38800000u) {
+      // Subnormal or zero.
+      float a;
+      std::memcpy(&a, &abs, sizeof(a));
+      return uint16_t(sign | uint32_t(std::nearbyint(a * 16777216.f)));
+    }
+    uint32_t rounded = abs + 0xfffu + ((abs >> 13) & 1u);
+    return uint16_t(sign | ((rounded - 0x38000000u) >> 13));
+  }
+
+  /// Convert floats to half floats.
+  static inline void floats_to_halves(const float *in, uint16_t *out, size_t n) {
+    size_t i = 0;
+#if defined(FOGL_VERTEX_PACK_F16C)
+    for (; i + 4 <= n; i += 4)
+      _mm_storel_epi64(reinterpret_cast<__m128i*>(out + i), _mm_cvtps_ph(_mm_loadu_ps(in + i), _MM_FROUND_TO_NEAREST_INT));
+#elif defined(FOGL_VERTEX_PACK_NEON) && defined(__ARM_FP16_FORMAT_IEEE)
+    for (; i + 4 <= n; i += 4)
+      vst1_u16(out + i, vreinterpret_u16_f16(vcvt_f16_f32(vld1q_f32(in + i))));
+#endif
+    for (; i < n; ++i)
+      out[i] = float_to_half(in[i]);
+  }
+
+  /// Compute round(clamp(f * scale + bias, lo, hi)) for each float.
+  static inline void quantize(const float *in, int32_t *out, size_t n, float scale, float bias, float lo, float hi) {
+    size_t i = 0;
+#if defined(FOGL_VERTEX_PACK_SSE2)
+    const __m128 s = _mm_set1_ps(scale), b = _mm_set1_ps(bias), l = _mm_set1_ps(lo), h = _mm_set1_ps(hi);
+    for (; i + 4 <= n; i += 4) {
+      __m128 v = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(in + i), s), b);
+      v = _mm_min_ps(_mm_max_ps(v, l), h);
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_cvtps_epi32(v));
+    }
+#elif defined(FOGL_VERTEX_PACK_NEON)
+    const float32x4_t s = vdupq_n_f32(scale), b = vdupq_n_f32(bias), l = vdupq_n_f32(lo), h = vdupq_n_f32(hi);
+    for (; i + 4 <= n; i += 4) {
+      float32x4_t v = vmlaq_f32(b, vld1q_f32(in + i), s);
+      v = vminq_f32(vmaxq_f32(v, l), h);
+#if defined(__aarch64__)
+      vst1q_s32(out + i, vcvtnq_s32_f32(v));
+#else
+      // Round half away from zero, then truncate.
+      uint32x4_t negative = vcltq_f32(v, vdupq_n_f32(0.f));
+      v = vaddq_f32(v, vbslq_f32(negative, vdupq_n_f32(-.5f), vdupq_n_f32(.5f)));
+      vst1q_s32(out + i, vcvtq_s32_f32(v));
+#endif
+    }
+#endif
+    for (; i < n; ++i) {
+      float v = std::fmin(std::fmax(in[i] * scale + bias, lo), hi);
+      out[i] = int32_t(std::nearbyint(v));
+    }
+  }
+
+  /// Octahedral encode unit vectors with three components into two components in [-1, 1].
+  static inline void octahedral_encode(const float *in, float *out, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+      float x = in[i * 3], y = in[i * 3 + 1], z = in[i * 3 + 2];
+      float l1 = std::fabs(x) + std::fabs(y) + std::fabs(z);
+      if (l1 > 0.f) {
+        x /= l1;
+        y /= l1;
+      }
+      if (z < 0.f) {
+        float ox = (1.f - std::fabs(y)) * (x >= 0.f ? 1.f : -1.f);
+        float oy = (1.f - std::fabs(x)) * (y >= 0.f ? 1.f : -1.f);
+        x = ox;
+        y = oy;
+      }
+      out[i * 2] = x;
+      out[i * 2 + 1] = y;
+    }
+  }
+
+  /// Exception which is thrown if a stream cannot be packed with its encoding.
+  struct bad_attribute_stream : exception {
+  };
+
+  /// Interleave float streams into one vertex buffer, quantizing each stream according to its encoding.
+  /// Attributes are aligned to four bytes. Signed normalized values use the GLES 2.0 mapping (2c + 1) / (2^b - 1).
+  static inline packed_vertices pack_vertices(std::initializer_list<attribute_stream> streams, size_t vertex_count) {
+    packed_vertices packed;
+    packed.stride = 0;
+    for (const attribute_stream &s : streams) {
+      attribute_format f;
+      f.size = s.components;
+      f.normalized = GL_TRUE;
+      size_t component_size = 0;
+      switch (s.encoding) {
+        case attribute_encoding::float32: f.type = GL_FLOAT; f.normalized = GL_FALSE; component_size = 4; break;
+        case attribute_encoding::half_float: f.type = GL_HALF_FLOAT_OES; f.normalized = GL_FALSE; component_size = 2; break;
+        case attribute_encoding::snorm16: f.type = GL_SHORT; component_size = 2; break;
+        case attribute_encoding::unorm16: f.type = GL_UNSIGNED_SHORT; component_size = 2; break;
+        case attribute_encoding::snorm8: f.type = GL_BYTE; component_size = 1; break;
+        case attribute_encoding::unorm8: f.type = GL_UNSIGNED_BYTE; component_size = 1; break;
+        case attribute_encoding::octahedral16: f.type = GL_SHORT; f.size = 2; component_size = 2; break;
+        case attribute_encoding::octahedral8: f.type = GL_BYTE; f.size = 2; component_size = 1; break;
+      }
+      bool octahedral = s.encoding == attribute_encoding::octahedral16 || s.encoding == attribute_encoding::octahedral8;
+      if (s.components < 1 || s.components > 4 || (octahedral && s.components != 3))
+        throw bad_attribute_stream();
+      f.offset = packed.stride;
+      packed.stride += GLsizei((f.size * component_size + 3) & ~size_t(3));
+      packed.attributes.push_back(f);
+    }
+    packed.data.assign(packed.stride * vertex_count, 0);
+
+    std::vector<float> encoded;
+    std::vector<int32_t> quantized;
+    std::vector<uint16_t> halves;
+    size_t a = 0;
+    for (const attribute_stream &s : streams) {
+      const attribute_format &f = packed.attributes[a++];
+      const float *in = s.data;
+      size_t n = vertex_count * f.size;
+      if (s.encoding == attribute_encoding::octahedral16 || s.encoding == attribute_encoding::octahedral8) {
+        encoded.resize(n);
+        octahedral_encode(s.data, encoded.data(), vertex_count);
+        in = encoded.data();
+      }
+      unsigned char *out = packed.data.data() + f.offset;
+      switch (f.type) {
+        case GL_FLOAT:
+          for (size_t v = 0; v < vertex_count; ++v)
+            std::memcpy(out + v * packed.stride, in + v * f.size, f.size * sizeof(float));
+          continue;
+        case GL_HALF_FLOAT_OES:
+          halves.resize(n);
+          floats_to_halves(in, halves.data(), n);
+          for (size_t v = 0; v < vertex_count; ++v)
+            std::memcpy(out + v * packed.stride, &halves[v * f.size], f.size * sizeof(uint16_t));
+          continue;
+      }
+      quantized.resize(n);
+      switch (f.type) {
+        case GL_SHORT: quantize(in, quantized.data(), n, 32767.5f, -.5f, -32768.f, 32767.f); break;
+        case GL_UNSIGNED_SHORT: quantize(in, quantized.data(), n, 65535.f, 0.f, 0.f, 65535.f); break;
+        case GL_BYTE: quantize(in, quantized.data(), n, 127.5f, -.5f, -128.f, 127.f); break;
+        case GL_UNSIGNED_BYTE: quantize(in, quantized.data(), n, 255.f, 0.f, 0.f, 255.f); break;
+      }
+      for (size_t v = 0; v < vertex_count; ++v) {
+        unsigned char *dst = out + v * packed.stride;
+        const int32_t *src = &quantized[v * f.size];
+        for (GLint c = 0; c < f.size; ++c) {
+          if (f.type == GL_SHORT || f.type == GL_UNSIGNED_SHORT) {
+            uint16_t q = uint16_t(src[c]);
+            std::memcpy(dst + c * 2, &q, 2);
+          } else {
+            dst[c] = uint8_t(src[c]);
+          }
+        }
+      }
+    }
+    return packed;
+  }
+
+}